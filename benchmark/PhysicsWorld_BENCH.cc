@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/* Desc: Benchmarks of the calls of the PhysicsWorld interface
+ * with the Gazebo engines
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/GazeboWorldLoader.hh>
+#include <collision_benchmark/GazeboPhysicsWorld.hh>
+#include <collision_benchmark/PrimitiveShape.hh>
+#include <collision_benchmark/BasicTypes.hh>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using collision_benchmark::GazeboPhysicsWorld;
+using collision_benchmark::GazeboWorldLoader;
+using collision_benchmark::PhysicsWorldBaseInterface;
+using collision_benchmark::PrimitiveShape;
+using collision_benchmark::Shape;
+using collision_benchmark::BasicState;
+using collision_benchmark::Vector3;
+
+// the world which is loaded with each engine
+std::string emptyWorldFile = "test_worlds/void.world";
+
+// engines to benchmark, indexed by the first argument of the benchmarks
+const std::vector<std::string> engines = {"ode", "bullet", "dart"};
+
+// numbers of models in the scenes, the second argument of the benchmarks
+const std::vector<int> sceneSizes = {1, 10, 100};
+
+// Adds the arguments (engine index, number of models) of all scenes
+void SceneArguments(benchmark::internal::Benchmark * b)
+{
+  b->ArgNames({"engine", "models"});
+  for (unsigned int e = 0; e < engines.size(); ++e)
+  {
+    for (unsigned int s = 0; s < sceneSizes.size(); ++s)
+    {
+      b->Args({static_cast<int>(e), sceneSizes[s]});
+    }
+  }
+}
+
+/**
+ * \brief Loads the empty world with the engine given in the first argument
+ * and adds as many spheres as given in the second argument. The spheres are
+ * placed in a row in which each sphere intersects its neighbours, so that
+ * there are contacts between all neighbours.
+ *
+ * The dynamics are disabled, so that the scene stays the same in
+ * all iterations, while the contacts are still computed.
+ */
+class PhysicsWorldFixture: public benchmark::Fixture
+{
+  public: virtual void SetUp(const benchmark::State& state)
+  {
+    const std::string& engine = engines[state.range(0)];
+    std::stringstream worldname;
+    worldname << "benchmark_" << engine << "_" << worldCnt++;
+    GazeboWorldLoader loader(engine);
+    PhysicsWorldBaseInterface::Ptr w =
+      loader.LoadFromFile(emptyWorldFile, worldname.str());
+    world = std::dynamic_pointer_cast<GazeboPhysicsWorld>(w);
+    if (!world)
+    {
+      std::cerr << "Could not load world with " << engine << std::endl;
+      return;
+    }
+    world->SetDynamicsEnabled(false);
+    world->SetPaused(false);
+
+    const double radius = 0.5;
+    models.clear();
+    for (int i = 0; i < state.range(1); ++i)
+    {
+      std::stringstream name;
+      name << "sphere_" << i;
+      Shape::Ptr shape(PrimitiveShape::CreateSphere(radius));
+      GazeboPhysicsWorld::ModelLoadResult res =
+        world->AddModelFromShape(name.str(), shape, shape);
+      if (res.opResult != collision_benchmark::SUCCESS)
+      {
+        std::cerr << "Could not add model " << name.str() << std::endl;
+        continue;
+      }
+      BasicState modelState;
+      modelState.SetPosition(Vector3(i * 1.6 * radius, 0, 0));
+      world->SetBasicModelState(res.modelID, modelState);
+      models.push_back(res.modelID);
+    }
+    world->Update(1);
+  }
+
+  public: virtual void TearDown(const benchmark::State&)
+  {
+    world.reset();
+    gazebo::physics::remove_worlds();
+  }
+
+  // \return false and skips the benchmark if the scene could not be loaded
+  protected: bool IsValid(benchmark::State& state)
+  {
+    if (world && !models.empty()) return true;
+    state.SkipWithError("Scene could not be loaded");
+    return false;
+  }
+
+  protected: GazeboPhysicsWorld::Ptr world;
+  protected: std::vector<GazeboPhysicsWorld::ModelID> models;
+  protected: static int worldCnt;
+};
+
+int PhysicsWorldFixture::worldCnt = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+BENCHMARK_DEFINE_F(PhysicsWorldFixture, Update)(benchmark::State& state)
+{
+  if (!IsValid(state)) return;
+  state.SetLabel(engines[state.range(0)]);
+  for (auto _ : state)
+  {
+    world->Update(1);
+  }
+}
+BENCHMARK_REGISTER_F(PhysicsWorldFixture, Update)->Apply(SceneArguments);
+
+//////////////////////////////////////////////////////////////////////////////
+BENCHMARK_DEFINE_F(PhysicsWorldFixture, GetContactInfo)
+  (benchmark::State& state)
+{
+  if (!IsValid(state)) return;
+  state.SetLabel(engines[state.range(0)]);
+  for (auto _ : state)
+  {
+    std::vector<GazeboPhysicsWorld::ContactInfoPtr> contacts =
+      world->GetContactInfo();
+    benchmark::DoNotOptimize(contacts);
+  }
+}
+BENCHMARK_REGISTER_F(PhysicsWorldFixture, GetContactInfo)
+  ->Apply(SceneArguments);
+
+//////////////////////////////////////////////////////////////////////////////
+BENCHMARK_DEFINE_F(PhysicsWorldFixture, SetBasicModelState)
+  (benchmark::State& state)
+{
+  if (!IsValid(state)) return;
+  state.SetLabel(engines[state.range(0)]);
+  std::vector<BasicState> states(models.size());
+  for (unsigned int i = 0; i < models.size(); ++i)
+    world->GetBasicModelState(models[i], states[i]);
+  unsigned int i = 0;
+  for (auto _ : state)
+  {
+    world->SetBasicModelState(models[i], states[i]);
+    i = (i + 1) % models.size();
+  }
+}
+BENCHMARK_REGISTER_F(PhysicsWorldFixture, SetBasicModelState)
+  ->Apply(SceneArguments);
+
+//////////////////////////////////////////////////////////////////////////////
+BENCHMARK_DEFINE_F(PhysicsWorldFixture, GetAABB)(benchmark::State& state)
+{
+  if (!IsValid(state)) return;
+  state.SetLabel(engines[state.range(0)]);
+  GazeboPhysicsWorld::Vector3 min, max;
+  unsigned int i = 0;
+  for (auto _ : state)
+  {
+    world->GetAABB(models[i], min, max);
+    benchmark::DoNotOptimize(min);
+    i = (i + 1) % models.size();
+  }
+}
+BENCHMARK_REGISTER_F(PhysicsWorldFixture, GetAABB)->Apply(SceneArguments);
+
+//////////////////////////////////////////////////////////////////////////////
+BENCHMARK_DEFINE_F(PhysicsWorldFixture, GetWorldState)
+  (benchmark::State& state)
+{
+  if (!IsValid(state)) return;
+  state.SetLabel(engines[state.range(0)]);
+  for (auto _ : state)
+  {
+    GazeboPhysicsWorld::WorldState worldState = world->GetWorldState();
+    benchmark::DoNotOptimize(worldState);
+  }
+}
+BENCHMARK_REGISTER_F(PhysicsWorldFixture, GetWorldState)
+  ->Apply(SceneArguments);
+
+//////////////////////////////////////////////////////////////////////////////
+BENCHMARK_DEFINE_F(PhysicsWorldFixture, SetWorldState)
+  (benchmark::State& state)
+{
+  if (!IsValid(state)) return;
+  state.SetLabel(engines[state.range(0)]);
+  GazeboPhysicsWorld::WorldState worldState = world->GetWorldState();
+  for (auto _ : state)
+  {
+    world->SetWorldState(worldState, false);
+  }
+}
+BENCHMARK_REGISTER_F(PhysicsWorldFixture, SetWorldState)
+  ->Apply(SceneArguments);
+
+//////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+  benchmark::Initialize(&argc, argv);
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--world") == 0)
+    {
+      if (i+1 >= argc)
+      {
+        std::cerr << "--world requires specification of a file" << std::endl;
+        continue;
+      }
+      ++i;
+      emptyWorldFile = argv[i];
+    }
+    else
+    {
+      std::cerr << "Unrecognized command line parameter: "
+                << argv[i] << std::endl;
+    }
+  }
+
+  const char * fakeProgramName = "PhysicsWorldBenchmark";
+  gazebo::setupServer(1, (char**)&fakeProgramName);
+  gazebo::common::Console::SetQuiet(true);
+
+  benchmark::RunSpecifiedBenchmarks();
+
+  gazebo::shutdown();
+  return 0;
+}
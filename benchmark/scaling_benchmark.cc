@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Measures the step throughput of the engines for an increasing
+ * number of models in the world
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+
+#include <collision_benchmark/GazeboWorldLoader.hh>
+#include <collision_benchmark/GazeboPhysicsWorld.hh>
+#include <collision_benchmark/GazeboHelpers.hh>
+#include <collision_benchmark/PrimitiveShape.hh>
+#include <collision_benchmark/SimpleTriMeshShape.hh>
+#include <collision_benchmark/MeshShapeGeneratorVtk.hh>
+#include <collision_benchmark/BasicTypes.hh>
+
+#include <gazebo/gazebo.hh>
+
+#include <boost/program_options.hpp>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using collision_benchmark::GazeboPhysicsWorld;
+using collision_benchmark::GazeboWorldLoader;
+using collision_benchmark::PhysicsWorldBaseInterface;
+using collision_benchmark::PrimitiveShape;
+using collision_benchmark::SimpleTriMeshShape;
+using collision_benchmark::Shape;
+using collision_benchmark::BasicState;
+
+namespace po = boost::program_options;
+
+// Parameters of the scenes which are measured
+struct ScalingParameters
+{
+  std::string worldFile;
+  // number of steps to measure
+  int steps;
+  // fraction of the models which are meshes, the others are primitives
+  double meshFraction;
+  // number of models per cubic meter. The scene grows with the number
+  // of models so that the number of contacts per model stays about the same.
+  double density;
+  // whether the dynamics are enabled or only the contacts are computed
+  bool dynamics;
+  unsigned int seed;
+};
+
+// Result of one engine and number of models. This is sent from the
+// process which runs the measurement to the parent, so it must be POD.
+struct ScalingPoint
+{
+  int32_t ok;
+  uint32_t numModels;
+  uint32_t numMeshes;
+  // time to load the models, in seconds
+  double loadTime;
+  double stepsPerSecond;
+  double contactsPerStep;
+  // peak resident set size of the process, in kilobytes
+  int64_t peakRSS;
+};
+
+/////////////////////////////////////////////////
+// \return a failed measurement with \e numModels
+ScalingPoint EmptyPoint(const unsigned int numModels)
+{
+  ScalingPoint point;
+  point.ok = 0;
+  point.numModels = numModels;
+  point.numMeshes = 0;
+  point.loadTime = 0;
+  point.stepsPerSecond = 0;
+  point.contactsPerStep = 0;
+  point.peakRSS = 0;
+  return point;
+}
+
+/////////////////////////////////////////////////
+// Loads the world with \e engine, adds \e numModels randomly placed models
+// and steps it.
+// \return the result, in which the peak RSS is not set yet.
+ScalingPoint MeasureScene(const std::string& engine,
+                          const unsigned int numModels,
+                          const ScalingParameters& params)
+{
+  ScalingPoint point = EmptyPoint(numModels);
+
+  GazeboWorldLoader loader(engine);
+  PhysicsWorldBaseInterface::Ptr w =
+    loader.LoadFromFile(params.worldFile, "scaling_" + engine);
+  GazeboPhysicsWorld::Ptr world =
+    std::dynamic_pointer_cast<GazeboPhysicsWorld>(w);
+  if (!world)
+  {
+    std::cerr << "Could not load world with " << engine << std::endl;
+    return point;
+  }
+  world->SetDynamicsEnabled(params.dynamics);
+  world->SetPaused(false);
+
+  const double size = 0.5;
+  typedef SimpleTriMeshShape::MeshDataT::VertexPrecision Precision;
+  collision_benchmark::MeshShapeGenerator<Precision>::Ptr generator
+      (new collision_benchmark::MeshShapeGeneratorVtk<Precision>());
+  std::vector<Shape::Ptr> meshes;
+  meshes.push_back(Shape::Ptr(new SimpleTriMeshShape(
+    generator->MakeSphere(size, 10, 10), "ScalingSphereMesh")));
+  meshes.push_back(Shape::Ptr(new SimpleTriMeshShape(
+    generator->MakeBox(2 * size, 2 * size, 2 * size), "ScalingBoxMesh")));
+
+  const double extent = std::cbrt(numModels / params.density);
+  std::mt19937 rng(params.seed);
+  std::uniform_real_distribution<double> coord(-extent / 2, extent / 2);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < numModels; ++i)
+  {
+    std::stringstream name;
+    name << "model_" << i;
+    const bool isMesh = unit(rng) < params.meshFraction;
+    Shape::Ptr shape;
+    if (isMesh)
+      shape = meshes[i % meshes.size()];
+    else if (i % 2 == 0)
+      shape.reset(PrimitiveShape::CreateSphere(size));
+    else
+      shape.reset(PrimitiveShape::CreateBox(2 * size, 2 * size, 2 * size));
+
+    GazeboPhysicsWorld::ModelLoadResult res =
+      world->AddModelFromShape(name.str(), shape, shape);
+    if (res.opResult != collision_benchmark::SUCCESS)
+    {
+      std::cerr << "Could not add model " << name.str() << std::endl;
+      return point;
+    }
+    BasicState modelState;
+    modelState.SetPosition(coord(rng), coord(rng), coord(rng));
+    world->SetBasicModelState(res.modelID, modelState);
+    if (isMesh) ++point.numMeshes;
+  }
+  point.loadTime = std::chrono::duration<double>
+    (std::chrono::steady_clock::now() - start).count();
+
+  // only the time of the steps is measured, not the retrieval of contacts
+  double stepTime = 0;
+  uint64_t numContacts = 0;
+  GazeboPhysicsWorld::ContactBuffer contacts;
+  for (int i = 0; i < params.steps; ++i)
+  {
+    start = std::chrono::steady_clock::now();
+    world->Update(1);
+    stepTime += std::chrono::duration<double>
+      (std::chrono::steady_clock::now() - start).count();
+    // count the contact points, not the pairs of colliding models
+    world->FillContactBuffer(contacts);
+    numContacts += contacts.GetNumContacts();
+  }
+  if (stepTime > 0) point.stepsPerSecond = params.steps / stepTime;
+  if (params.steps > 0)
+    point.contactsPerStep = numContacts / static_cast<double>(params.steps);
+  point.ok = 1;
+  return point;
+}
+
+/////////////////////////////////////////////////
+// Runs MeasureScene() in a separate process, so that each measurement
+// starts with a fresh Gazebo and the peak RSS only includes this scene.
+// A crash of the engine is reported as a failed measurement.
+ScalingPoint RunScene(const std::string& engine,
+                      const unsigned int numModels,
+                      const ScalingParameters& params)
+{
+  ScalingPoint point = EmptyPoint(numModels);
+
+  int fd[2];
+  if (pipe(fd) != 0)
+  {
+    std::cerr << "Could not create pipe" << std::endl;
+    return point;
+  }
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    std::cerr << "Could not fork" << std::endl;
+    close(fd[0]);
+    close(fd[1]);
+    return point;
+  }
+  if (pid == 0)
+  {
+    close(fd[0]);
+    const char * fakeProgramName = "ScalingBenchmark";
+    gazebo::setupServer(1, (char**)&fakeProgramName);
+    gazebo::common::Console::SetQuiet(true);
+    ScalingPoint result = MeasureScene(engine, numModels, params);
+    gazebo::shutdown();
+    ssize_t written = write(fd[1], &result, sizeof(result));
+    close(fd[1]);
+    _exit(written == sizeof(result) ? 0 : 1);
+  }
+
+  close(fd[1]);
+  ScalingPoint result;
+  ssize_t numRead = read(fd[0], &result, sizeof(result));
+  close(fd[0]);
+
+  int status = 0;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0)
+  {
+    std::cerr << "Could not wait for the measurement of " << engine
+              << std::endl;
+    return point;
+  }
+  if (numRead != sizeof(result) || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0)
+  {
+    std::cerr << "Measurement of " << engine << " with " << numModels
+              << " models did not finish" << std::endl;
+    return point;
+  }
+  result.peakRSS = usage.ru_maxrss;
+  return result;
+}
+
+/////////////////////////////////////////////////
+void WriteCSV(std::ostream& out,
+              const std::vector<std::string>& engines,
+              const std::vector<ScalingPoint>& points)
+{
+  out << "engine,models,meshes,ok,load_time_s,steps_per_s,"
+      << "contacts_per_step,peak_rss_kb" << std::endl;
+  for (unsigned int i = 0; i < points.size(); ++i)
+  {
+    const ScalingPoint& p = points[i];
+    out << engines[i] << "," << p.numModels << "," << p.numMeshes << ","
+        << p.ok << "," << p.loadTime << "," << p.stepsPerSecond << ","
+        << p.contactsPerStep << "," << p.peakRSS << std::endl;
+  }
+}
+
+/////////////////////////////////////////////////
+void WriteJSON(std::ostream& out,
+               const ScalingParameters& params,
+               const std::vector<std::string>& engines,
+               const std::vector<ScalingPoint>& points)
+{
+  out << "{" << std::endl;
+  out << "  \"steps\": " << params.steps << "," << std::endl;
+  out << "  \"mesh_fraction\": " << params.meshFraction << "," << std::endl;
+  out << "  \"density\": " << params.density << "," << std::endl;
+  out << "  \"dynamics\": " << (params.dynamics ? "true" : "false")
+      << "," << std::endl;
+  out << "  \"results\": [" << std::endl;
+  for (unsigned int i = 0; i < points.size(); ++i)
+  {
+    const ScalingPoint& p = points[i];
+    out << "    {\"engine\": \"" << engines[i] << "\", "
+        << "\"models\": " << p.numModels << ", "
+        << "\"meshes\": " << p.numMeshes << ", "
+        << "\"ok\": " << (p.ok ? "true" : "false") << ", "
+        << "\"load_time_s\": " << p.loadTime << ", "
+        << "\"steps_per_s\": " << p.stepsPerSecond << ", "
+        << "\"contacts_per_step\": " << p.contactsPerStep << ", "
+        << "\"peak_rss_kb\": " << p.peakRSS << "}"
+        << (i + 1 < points.size() ? "," : "") << std::endl;
+  }
+  out << "  ]" << std::endl;
+  out << "}" << std::endl;
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ScalingParameters params;
+  std::vector<std::string> engines;
+  std::vector<unsigned int> numModels;
+  std::string format;
+  std::string outputFile;
+
+  // Declare the supported options.
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "Produce help message")
+    ("engine,e", po::value<std::vector<std::string>>(&engines)->multitoken(),
+      "Engine(s) to measure. Defaults to all supported engines.")
+    ("models,n",
+      po::value<std::vector<unsigned int>>(&numModels)->multitoken(),
+      "Number(s) of models to measure. Defaults to 10 to 10000.")
+    ("steps,s", po::value<int>(&params.steps)->default_value(100),
+      "Number of steps to measure for each number of models")
+    ("mesh-fraction,m",
+      po::value<double>(&params.meshFraction)->default_value(0.5),
+      "Fraction of the models which are meshes")
+    ("density,d", po::value<double>(&params.density)->default_value(0.5),
+      "Number of models per cubic meter")
+    ("static", "Disable the dynamics and only compute the contacts")
+    ("seed", po::value<unsigned int>(&params.seed)->default_value(0),
+      "Seed for the placement of the models")
+    ("world,w", po::value<std::string>(&params.worldFile)
+      ->default_value("test_worlds/void.world"),
+      "World to add the models to")
+    ("format,f", po::value<std::string>(&format)->default_value("csv"),
+      "Output format, csv or json")
+    ("output,o", po::value<std::string>(&outputFile),
+      "File to write the results to. Defaults to the standard output.")
+    ;
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || ((format != "csv") && (format != "json")))
+  {
+    std::cout << argv[0] << " [options]" << std::endl;
+    std::cout << desc << std::endl;
+    return 1;
+  }
+  params.dynamics = !vm.count("static");
+
+  if (engines.empty())
+  {
+    std::set<std::string> supported =
+      collision_benchmark::GetSupportedPhysicsEngines();
+    engines.insert(engines.end(), supported.begin(), supported.end());
+  }
+  if (numModels.empty())
+  {
+    numModels = {10, 30, 100, 300, 1000, 3000, 10000};
+  }
+
+  std::vector<std::string> pointEngines;
+  std::vector<ScalingPoint> points;
+  for (std::vector<std::string>::const_iterator e = engines.begin();
+       e != engines.end(); ++e)
+  {
+    for (std::vector<unsigned int>::const_iterator n = numModels.begin();
+         n != numModels.end(); ++n)
+    {
+      std::cerr << "Measuring " << *e << " with " << *n << " models"
+                << std::endl;
+      pointEngines.push_back(*e);
+      points.push_back(RunScene(*e, *n, params));
+    }
+  }
+
+  std::ofstream file;
+  if (!outputFile.empty())
+  {
+    file.open(outputFile.c_str());
+    if (!file)
+    {
+      std::cerr << "Could not write " << outputFile << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& out = outputFile.empty() ? std::cout : file;
+  if (format == "json") WriteJSON(out, params, pointEngines, points);
+  else WriteCSV(out, pointEngines, points);
+  return 0;
+}
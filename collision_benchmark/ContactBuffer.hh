@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Flat buffer of contact points which can be re-used between steps
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_CONTACTBUFFER_H
+#define COLLISION_BENCHMARK_CONTACTBUFFER_H
+
+#include <collision_benchmark/ContactInfo.hh>
+
+#include <memory>
+#include <vector>
+
+namespace collision_benchmark
+{
+
+/**
+ * \brief Flat structure-of-arrays storage of contact points,
+ * as an alternative to a vector of ContactInfo.
+ *
+ * The buffer stores one entry per pair of colliding model parts (see
+ * Pair) and the data of all contact points in separate arrays, which
+ * are indexed with the contact index. The contact points of one pair are
+ * stored contiguously, starting at Pair::firstContact.
+ *
+ * The buffer is meant to be owned by the caller and re-used for each
+ * step: Clear() only resets the number of pairs and contacts, but keeps
+ * the memory. Once the buffer has grown to the largest number of
+ * contacts seen, filling it does not allocate memory any more.
+ *
+ * Template parameters:
+ * - Vector3Impl and WrenchImpl as in collision_benchmark::Contact
+ * - ModelIdImpl and ModelPartIdImpl as in collision_benchmark::ContactInfo
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+template<class Vector3Impl, class WrenchImpl,
+         typename ModelIdImpl, typename ModelPartIdImpl>
+class ContactBuffer
+{
+  public: typedef Vector3Impl Vector3;
+  public: typedef WrenchImpl Wrench;
+  public: typedef ModelIdImpl ModelID;
+  public: typedef ModelPartIdImpl ModelPartID;
+
+  private: typedef ContactBuffer<Vector3, Wrench, ModelID, ModelPartID> Self;
+  public: typedef std::shared_ptr<Self> Ptr;
+  public: typedef std::shared_ptr<const Self> ConstPtr;
+
+  public: typedef collision_benchmark::Contact<Vector3, Wrench> Contact;
+  public: typedef collision_benchmark::ContactInfo<Contact, ModelID,
+                                                   ModelPartID> ContactInfo;
+  public: typedef typename ContactNameResolver<ModelID, ModelPartID>::ConstPtr
+            NameResolverConstPtr;
+
+  /// A pair of model parts which are in contact. As in ContactInfo, the
+  /// first model is always lexicographically 'smaller' than the second,
+  /// also if the pair was added by the interned IDs.
+  /// Use the accessors of the buffer, e.g. GetModel1(), for the names.
+  public: struct Pair
+  {
+    Pair(): model1Id(-1), modelPart1Id(-1), model2Id(-1), modelPart2Id(-1),
+            firstContact(0), numContacts(0) {}
+    // interned IDs as in ContactInfo, or -1 if not set
+    int model1Id;
+    int modelPart1Id;
+    int model2Id;
+    int modelPart2Id;
+    // names, only set if the IDs are not set
+    ModelID model1;
+    ModelPartID modelPart1;
+    ModelID model2;
+    ModelPartID modelPart2;
+    // index of the first contact point of this pair
+    unsigned int firstContact;
+    // number of contact points of this pair
+    unsigned int numContacts;
+  };
+
+  public: ContactBuffer(): numPairs(0), numContacts(0) {}
+
+  /// Removes all pairs and contacts, keeping the allocated memory
+  public: void Clear()
+  {
+    numPairs = 0;
+    numContacts = 0;
+  }
+
+  /// \return number of pairs in the buffer
+  public: unsigned int GetNumPairs() const { return numPairs; }
+
+  /// \return number of contact points in the buffer
+  public: unsigned int GetNumContacts() const { return numContacts; }
+
+  /// \return the pair with index \e i < GetNumPairs()
+  public: const Pair& GetPair(const unsigned int i) const { return pairs[i]; }
+
+  /// Sets the object which looks up the names of the interned IDs
+  /// of the pairs added with AddPair(int, int, int, int).
+  public: void SetNameResolver(const NameResolverConstPtr& resolver)
+  {
+    if (nameResolver != resolver) nameResolver = resolver;
+  }
+
+  /// \return the object set with SetNameResolver(), or NULL
+  public: const NameResolverConstPtr& GetNameResolver() const
+  { return nameResolver; }
+
+  /// Adds a new pair given by the interned IDs of the models and parts,
+  /// whose names are looked up by the name resolver (see SetNameResolver())
+  /// only when needed. The names are not looked up here, so the caller
+  /// has to pass the models in order: the name of model 1 has to be
+  /// lexicographically 'smaller' than the name of model 2.
+  /// Contact points added with AddContact() subsequently
+  /// belong to this pair.
+  /// \return the index of the new pair
+  public: unsigned int AddPair(const int model1Id,
+                               const int modelPart1Id,
+                               const int model2Id,
+                               const int modelPart2Id)
+  {
+    Pair& p = NewPair();
+    p.model1Id = model1Id;
+    p.modelPart1Id = modelPart1Id;
+    p.model2Id = model2Id;
+    p.modelPart2Id = modelPart2Id;
+    return numPairs++;
+  }
+
+  /// Adds a new pair given by the names of the models and parts.
+  /// Model 1 and 2 are swapped if necessary, as in the constructor of
+  /// ContactInfo which takes the names.
+  /// Contact points added with AddContact() subsequently
+  /// belong to this pair.
+  /// \return the index of the new pair
+  public: unsigned int AddPair(const ModelID& model1,
+                               const ModelPartID& modelPart1,
+                               const ModelID& model2,
+                               const ModelPartID& modelPart2)
+  {
+    Pair& p = NewPair();
+    // assigning strings to the existing ones keeps their capacity
+    if (model1 < model2)
+    {
+      p.model1 = model1;
+      p.modelPart1 = modelPart1;
+      p.model2 = model2;
+      p.modelPart2 = modelPart2;
+    }
+    else
+    {
+      p.model1 = model2;
+      p.modelPart1 = modelPart2;
+      p.model2 = model1;
+      p.modelPart2 = modelPart1;
+    }
+    return numPairs++;
+  }
+
+  /// \return name of the first model of pair \e i < GetNumPairs()
+  public: ModelID GetModel1(const unsigned int i) const
+  {
+    const Pair& p = pairs[i];
+    if (p.model1Id < 0) return p.model1;
+    return nameResolver->GetModelName(p.model1Id);
+  }
+  /// \return name of the part of the first model of pair \e i
+  public: ModelPartID GetModelPart1(const unsigned int i) const
+  {
+    const Pair& p = pairs[i];
+    if (p.modelPart1Id < 0) return p.modelPart1;
+    return nameResolver->GetModelPartName(p.modelPart1Id);
+  }
+  /// \return name of the second model of pair \e i < GetNumPairs()
+  public: ModelID GetModel2(const unsigned int i) const
+  {
+    const Pair& p = pairs[i];
+    if (p.model2Id < 0) return p.model2;
+    return nameResolver->GetModelName(p.model2Id);
+  }
+  /// \return name of the part of the second model of pair \e i
+  public: ModelPartID GetModelPart2(const unsigned int i) const
+  {
+    const Pair& p = pairs[i];
+    if (p.modelPart2Id < 0) return p.modelPart2;
+    return nameResolver->GetModelPartName(p.modelPart2Id);
+  }
+
+  /// Removes the pair which was last added, along with its contact points.
+  public: void RemoveLastPair()
+  {
+    if (numPairs == 0) return;
+    --numPairs;
+    numContacts = pairs[numPairs].firstContact;
+  }
+
+  /// Adds a contact point to the pair which was last added with AddPair().
+  /// Must not be called before a pair has been added.
+  public: void AddContact(const Vector3& position,
+                          const Vector3& normal,
+                          const Wrench& wrench,
+                          const double depth)
+  {
+    if (numContacts == depths.size())
+    {
+      size_t size = depths.size() * 2 + 1;
+      pairIndices.resize(size);
+      positions.resize(size);
+      normals.resize(size);
+      wrenches.resize(size);
+      depths.resize(size);
+    }
+    pairIndices[numContacts] = numPairs - 1;
+    positions[numContacts] = position;
+    normals[numContacts] = normal;
+    wrenches[numContacts] = wrench;
+    depths[numContacts] = depth;
+    ++numContacts;
+    ++pairs[numPairs - 1].numContacts;
+  }
+
+  /// \return index of the pair of contact \e i < GetNumContacts()
+  public: unsigned int GetPairIndex(const unsigned int i) const
+  { return pairIndices[i]; }
+  /// \return position of contact \e i < GetNumContacts()
+  public: const Vector3& GetPosition(const unsigned int i) const
+  { return positions[i]; }
+  /// \return normal of contact \e i < GetNumContacts()
+  public: const Vector3& GetNormal(const unsigned int i) const
+  { return normals[i]; }
+  /// \return wrench of contact \e i < GetNumContacts()
+  public: const Wrench& GetWrench(const unsigned int i) const
+  { return wrenches[i]; }
+  /// \return depth of contact \e i < GetNumContacts(),
+  ///   see also Contact::depth.
+  public: double GetDepth(const unsigned int i) const
+  { return depths[i]; }
+
+  /// Returns the largest depth of all contact points in \e max.
+  /// \return false if there are no contacts
+  public: bool MaxDepth(double& max) const
+  {
+    if (numContacts == 0) return false;
+    max = depths[0];
+    for (unsigned int i = 1; i < numContacts; ++i)
+    {
+      if (depths[i] > max) max = depths[i];
+    }
+    return true;
+  }
+
+  /// Appends all contact points in \e info as a new pair.
+  /// The names are copied, the interned IDs are not.
+  public: void Add(const ContactInfo& info)
+  {
+    AddPair(info.model1, info.modelPart1, info.model2, info.modelPart2);
+    for (typename std::vector<Contact>::const_iterator
+         it = info.contacts.begin(); it != info.contacts.end(); ++it)
+    {
+      AddContact(it->position, it->normal, it->wrench, it->depth);
+    }
+  }
+
+  /// Creates a ContactInfo with all contact points of the pair \e i.
+  /// This allocates memory, so it is meant for compatibility
+  /// with code using ContactInfo, not for use in each step.
+  public: typename ContactInfo::Ptr GetContactInfo(const unsigned int i) const
+  {
+    const Pair& p = pairs[i];
+    typename ContactInfo::Ptr info;
+    if (p.model1Id < 0)
+    {
+      info.reset(new ContactInfo(p.model1, p.modelPart1,
+                                 p.model2, p.modelPart2));
+    }
+    else
+    {
+      info.reset(new ContactInfo(nameResolver->GetModelName(p.model1Id),
+                            nameResolver->GetModelPartName(p.modelPart1Id),
+                            nameResolver->GetModelName(p.model2Id),
+                            nameResolver->GetModelPartName(p.modelPart2Id),
+                            p.model1Id, p.modelPart1Id,
+                            p.model2Id, p.modelPart2Id));
+    }
+    info->contacts.reserve(p.numContacts);
+    for (unsigned int c = p.firstContact;
+         c < p.firstContact + p.numContacts; ++c)
+    {
+      info->contacts.push_back(Contact(positions[c], normals[c],
+                                       wrenches[c], depths[c]));
+    }
+    return info;
+  }
+
+  // \return the next unused pair, with the IDs reset and no contacts
+  private: Pair& NewPair()
+  {
+    if (numPairs == pairs.size()) pairs.resize(pairs.size() * 2 + 1);
+    Pair& p = pairs[numPairs];
+    p.model1Id = -1;
+    p.modelPart1Id = -1;
+    p.model2Id = -1;
+    p.modelPart2Id = -1;
+    p.firstContact = numContacts;
+    p.numContacts = 0;
+    return p;
+  }
+
+  // all pairs. Only the first numPairs are used.
+  private: std::vector<Pair> pairs;
+  // number of pairs in use
+  private: unsigned int numPairs;
+
+  // data of the contact points. Only the first numContacts are used.
+  private: std::vector<unsigned int> pairIndices;
+  private: std::vector<Vector3> positions;
+  private: std::vector<Vector3> normals;
+  private: std::vector<Wrench> wrenches;
+  private: std::vector<double> depths;
+  // number of contact points in use
+  private: unsigned int numContacts;
+
+  // looks up the names of the pairs which were added by IDs
+  private: NameResolverConstPtr nameResolver;
+};
+
+}  // namespace collision_benchmark
+#endif  // COLLISION_BENCHMARK_CONTACTBUFFER_H
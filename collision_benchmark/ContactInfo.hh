@@ -65,6 +65,36 @@ class Contact
   public: double depth;
 };
 
+/**
+ * \brief Looks up the names of models and model parts by the interned
+ * IDs which are stored in ContactBuffer.
+ *
+ * Worlds which intern the names share an implementation of this
+ * with the contact buffers they fill, so that the names only have to be
+ * looked up when they are needed, e.g. for printing.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+template<typename ModelIdImpl, typename ModelPartIdImpl>
+class ContactNameResolver
+{
+  public: typedef ModelIdImpl ModelID;
+  public: typedef ModelPartIdImpl ModelPartID;
+
+  private: typedef ContactNameResolver<ModelID, ModelPartID> Self;
+  public: typedef std::shared_ptr<Self> Ptr;
+  public: typedef std::shared_ptr<const Self> ConstPtr;
+
+  public: virtual ~ContactNameResolver() {}
+
+  /// \return the name of the model with the interned ID \e id
+  public: virtual ModelID GetModelName(const int id) const = 0;
+
+  /// \return the name of the model part with the interned ID \e id
+  public: virtual ModelPartID GetModelPartName(const int id) const = 0;
+};
+
 /**
  * \brief Simple summary of basic contact point information
  * compatible with a variety of physics engines.
@@ -96,14 +126,22 @@ class ContactInfo
   public: typedef std::shared_ptr<Self> Ptr;
   public: typedef std::shared_ptr<const Self> ConstPtr;
 
-  public: ContactInfo(){}
+  public: ContactInfo():
+        model1Id(-1),
+        modelPart1Id(-1),
+        model2Id(-1),
+        modelPart2Id(-1) {}
   /// constructor which automatically swaps model1 and model2
   /// if necessary according to their lexicographicall order
   /// (model1 before model2)
   public: ContactInfo(const ModelID& model1_,
                       const ModelPartID& modelPart1_,
                       const ModelID& model2_,
-                      const ModelPartID& modelPart2_)
+                      const ModelPartID& modelPart2_):
+        model1Id(-1),
+        modelPart1Id(-1),
+        model2Id(-1),
+        modelPart2Id(-1)
   {
     if (model1_ < model2_)
     {
@@ -120,12 +158,42 @@ class ContactInfo
       modelPart2 =  modelPart1_;
     }
   }
+  /// constructor which additionally sets the interned IDs of the
+  /// models and parts. Swaps model1 and model2 along with their IDs
+  /// the same way as the constructor above.
+  public: ContactInfo(const ModelID& model1_,
+                      const ModelPartID& modelPart1_,
+                      const ModelID& model2_,
+                      const ModelPartID& modelPart2_,
+                      const int model1Id_, const int modelPart1Id_,
+                      const int model2Id_, const int modelPart2Id_):
+        ContactInfo(model1_, modelPart1_, model2_, modelPart2_)
+  {
+    if (model1_ < model2_)
+    {
+      model1Id = model1Id_;
+      modelPart1Id = modelPart1Id_;
+      model2Id = model2Id_;
+      modelPart2Id = modelPart2Id_;
+    }
+    else
+    {
+      model1Id = model2Id_;
+      modelPart1Id = modelPart2Id_;
+      model2Id = model1Id_;
+      modelPart2Id = modelPart1Id_;
+    }
+  }
   public: ContactInfo(const ContactInfo& c):
         contacts(c.contacts),
         model1(c.model1),
         modelPart1(c.modelPart1),
         model2(c.model2),
-        modelPart2(c.modelpart2){}
+        modelPart2(c.modelPart2),
+        model1Id(c.model1Id),
+        modelPart1Id(c.modelPart1Id),
+        model2Id(c.model2Id),
+        modelPart2Id(c.modelPart2Id) {}
   public: virtual ~ContactInfo() {}
 
   // checks for validity of the contact configuration
@@ -186,6 +254,14 @@ class ContactInfo
   public: ModelID model2;
   public: ModelPartID modelPart2;
 
+  // Interned IDs of model1, modelPart1, model2 and modelPart2, or -1 if
+  // the world which created the contact does not intern names.
+  // The IDs are only unique within the world which created the contact,
+  // so contacts of different worlds have to be compared by name.
+  public: int model1Id;
+  public: int modelPart1Id;
+  public: int model2Id;
+  public: int modelPart2Id;
 };
 
 }  // namespace
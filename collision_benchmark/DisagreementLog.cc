@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Compact binary log of states in which engines disagree
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/DisagreementLog.hh>
+
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using collision_benchmark::DisagreementLogWriter;
+using collision_benchmark::DisagreementLogReader;
+using collision_benchmark::DisagreementRecord;
+using collision_benchmark::DisagreementWorldSummary;
+
+const char DisagreementLogWriter::Magic[8] =
+  {'C', 'B', 'D', 'L', 'O', 'G', '\0', '\0'};
+const uint32_t DisagreementLogWriter::Version = 1;
+
+/////////////////////////////////////////////
+// Returns the strings of the header, null-terminated and
+// padded to a multiple of 8 bytes
+static std::vector<char>
+GetHeaderStrings(const std::string& model1,
+                 const std::string& model2,
+                 const std::vector<std::string>& sceneFiles)
+{
+  std::vector<char> strings;
+  strings.insert(strings.end(), model1.begin(), model1.end());
+  strings.push_back('\0');
+  strings.insert(strings.end(), model2.begin(), model2.end());
+  strings.push_back('\0');
+  for (std::vector<std::string>::const_iterator it = sceneFiles.begin();
+       it != sceneFiles.end(); ++it)
+  {
+    strings.insert(strings.end(), it->begin(), it->end());
+    strings.push_back('\0');
+  }
+  while (strings.size() % 8 != 0) strings.push_back('\0');
+  return strings;
+}
+
+/////////////////////////////////////////////
+DisagreementLogWriter::DisagreementLogWriter():
+  file(NULL),
+  numWorlds(0)
+{
+}
+
+/////////////////////////////////////////////
+DisagreementLogWriter::~DisagreementLogWriter()
+{
+  Close();
+}
+
+/////////////////////////////////////////////
+bool DisagreementLogWriter::Open(const std::string& filename,
+                                 const std::string& model1,
+                                 const std::string& model2,
+                                 const std::vector<std::string>& sceneFiles,
+                                 const bool append)
+{
+  Close();
+
+  std::vector<char> strings = GetHeaderStrings(model1, model2, sceneFiles);
+  FileHeader header;
+  memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.numWorlds = sceneFiles.size();
+  header.headerSize = sizeof(FileHeader) + strings.size();
+  header.recordSize = sizeof(DisagreementRecord) +
+    sceneFiles.size() * sizeof(DisagreementWorldSummary);
+
+  if (append)
+  {
+    file = fopen(filename.c_str(), "r+b");
+    if (file)
+    {
+      // only append if the existing log has the same header
+      FileHeader existing;
+      std::vector<char> existingStrings(strings.size());
+      bool same =
+        (fread(&existing, sizeof(FileHeader), 1, file) == 1) &&
+        (memcmp(&existing, &header, sizeof(FileHeader)) == 0) &&
+        (fread(existingStrings.data(), 1, strings.size(), file) ==
+         strings.size()) &&
+        (existingStrings == strings);
+      if (same && fseek(file, 0, SEEK_END) == 0)
+      {
+        // remove a record which is incomplete because the
+        // process was killed while writing it
+        long fileSize = ftell(file);
+        uint64_t numRecords =
+          (fileSize - header.headerSize) / header.recordSize;
+        uint64_t end = header.headerSize + numRecords * header.recordSize;
+        if ((static_cast<uint64_t>(fileSize) == end ||
+             ftruncate(fileno(file), end) == 0) &&
+            fseek(file, end, SEEK_SET) == 0)
+        {
+          numWorlds = sceneFiles.size();
+          return true;
+        }
+      }
+      fclose(file);
+      file = NULL;
+      std::cout << "Log " << filename << " does not match, "
+                << "overwriting it." << std::endl;
+    }
+  }
+
+  file = fopen(filename.c_str(), "wb");
+  if (!file)
+  {
+    std::cerr << "Could not open log " << filename << std::endl;
+    return false;
+  }
+  if ((fwrite(&header, sizeof(FileHeader), 1, file) != 1) ||
+      (fwrite(strings.data(), 1, strings.size(), file) != strings.size()) ||
+      (fflush(file) != 0))
+  {
+    std::cerr << "Could not write log " << filename << std::endl;
+    Close();
+    return false;
+  }
+  numWorlds = sceneFiles.size();
+  return true;
+}
+
+/////////////////////////////////////////////
+void DisagreementLogWriter::Close()
+{
+  if (file) fclose(file);
+  file = NULL;
+  numWorlds = 0;
+}
+
+/////////////////////////////////////////////
+bool DisagreementLogWriter::Write
+          (const DisagreementRecord& record,
+           const std::vector<DisagreementWorldSummary>& worlds)
+{
+  if (!file || (worlds.size() != numWorlds)) return false;
+  return (fwrite(&record, sizeof(DisagreementRecord), 1, file) == 1) &&
+         (fwrite(worlds.data(), sizeof(DisagreementWorldSummary),
+                 worlds.size(), file) == worlds.size()) &&
+         (fflush(file) == 0);
+}
+
+/////////////////////////////////////////////
+DisagreementRecord DisagreementLogWriter::CreateRecord
+                    (const unsigned int failure,
+                     const uint64_t cell,
+                     const BasicState& state)
+{
+  DisagreementRecord record;
+  memset(&record, 0, sizeof(DisagreementRecord));
+  record.failure = failure;
+  record.cell = cell;
+  record.position[0] = state.position.x;
+  record.position[1] = state.position.y;
+  record.position[2] = state.position.z;
+  if (state.RotEnabled())
+  {
+    record.rotation[0] = state.rotation.x;
+    record.rotation[1] = state.rotation.y;
+    record.rotation[2] = state.rotation.z;
+    record.rotation[3] = state.rotation.w;
+  }
+  return record;
+}
+
+/////////////////////////////////////////////
+DisagreementLogReader::DisagreementLogReader():
+  data(NULL),
+  size(0),
+  headerSize(0),
+  recordSize(0),
+  numRecords(0)
+{
+}
+
+/////////////////////////////////////////////
+DisagreementLogReader::~DisagreementLogReader()
+{
+  Close();
+}
+
+/////////////////////////////////////////////
+bool DisagreementLogReader::Open(const std::string& filename)
+{
+  Close();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    std::cerr << "Could not open log " << filename << std::endl;
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0) ||
+      (static_cast<size_t>(st.st_size) <
+       sizeof(DisagreementLogWriter::FileHeader)))
+  {
+    std::cerr << "Log " << filename << " is too small" << std::endl;
+    ::close(fd);
+    return false;
+  }
+  void * mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    std::cerr << "Could not map log " << filename << std::endl;
+    return false;
+  }
+  data = static_cast<const char*>(mapped);
+  size = st.st_size;
+
+  const DisagreementLogWriter::FileHeader * header =
+    reinterpret_cast<const DisagreementLogWriter::FileHeader*>(data);
+  if ((memcmp(header->magic, DisagreementLogWriter::Magic,
+              sizeof(DisagreementLogWriter::Magic)) != 0) ||
+      (header->version != DisagreementLogWriter::Version) ||
+      (header->headerSize > size) ||
+      (header->recordSize != sizeof(DisagreementRecord) +
+         header->numWorlds * sizeof(DisagreementWorldSummary)))
+  {
+    std::cerr << "File " << filename << " is no valid log" << std::endl;
+    Close();
+    return false;
+  }
+
+  // read the null-terminated strings after the header
+  std::vector<std::string> strings;
+  const char * str = data + sizeof(DisagreementLogWriter::FileHeader);
+  const char * stringsEnd = data + header->headerSize;
+  while ((strings.size() < header->numWorlds + 2) && (str < stringsEnd))
+  {
+    const char * end = static_cast<const char*>(memchr(str, '\0',
+                                                       stringsEnd - str));
+    if (!end) break;
+    strings.push_back(std::string(str, end));
+    str = end + 1;
+  }
+  if (strings.size() != header->numWorlds + 2)
+  {
+    std::cerr << "Log " << filename << " has an invalid header" << std::endl;
+    Close();
+    return false;
+  }
+  model1 = strings[0];
+  model2 = strings[1];
+  sceneFiles.assign(strings.begin() + 2, strings.end());
+
+  headerSize = header->headerSize;
+  recordSize = header->recordSize;
+  // an incomplete record at the end is ignored
+  numRecords = (size - headerSize) / recordSize;
+  return true;
+}
+
+/////////////////////////////////////////////
+void DisagreementLogReader::Close()
+{
+  if (data) munmap(const_cast<char*>(data), size);
+  data = NULL;
+  size = 0;
+  headerSize = 0;
+  recordSize = 0;
+  numRecords = 0;
+  model1.clear();
+  model2.clear();
+  sceneFiles.clear();
+}
+
+/////////////////////////////////////////////
+const DisagreementRecord&
+DisagreementLogReader::GetRecord(const uint64_t i) const
+{
+  return *reinterpret_cast<const DisagreementRecord*>
+    (data + headerSize + i * recordSize);
+}
+
+/////////////////////////////////////////////
+const DisagreementWorldSummary&
+DisagreementLogReader::GetWorldSummary(const uint64_t i,
+                                       const unsigned int w) const
+{
+  return reinterpret_cast<const DisagreementWorldSummary*>
+    (data + headerSize + i * recordSize + sizeof(DisagreementRecord))[w];
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Compact binary log of states in which engines disagree
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_DISAGREEMENTLOG_H
+#define COLLISION_BENCHMARK_DISAGREEMENTLOG_H
+
+#include <collision_benchmark/BasicTypes.hh>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace collision_benchmark
+{
+
+/// Collision state of one world in a DisagreementRecord
+struct DisagreementWorldSummary
+{
+  // 1 if the world found a collision between the models, 0 otherwise
+  uint32_t colliding;
+  // number of contact points between the models
+  uint32_t numContacts;
+  // largest depth of the contact points, or 0 if there are none
+  double maxDepth;
+};
+
+/// One state in which the worlds disagreed about the collision state.
+/// In the log file, each record is followed by one
+/// DisagreementWorldSummary per world.
+struct DisagreementRecord
+{
+  // number of the failure within the test
+  uint32_t failure;
+  uint32_t reserved;
+  // index of the cell in the sweep which failed
+  uint64_t cell;
+  // position of the moving model (x, y, z)
+  double position[3];
+  // orientation of the moving model as quaternion (x, y, z, w).
+  // All zero if the orientation was not changed.
+  double rotation[4];
+};
+
+/**
+ * \brief Writes an append-only binary log of states in which the worlds
+ * disagree about the collision state of two models.
+ *
+ * Instead of saving all worlds for each disagreement, the worlds are saved
+ * only once as a shared scene description, and each disagreement is
+ * logged as a fixed-size record with the state of the moving model and a
+ * summary of the contacts in each world. The full world files can be
+ * re-created from the scene and a record later, see DisagreementLogReader.
+ *
+ * File format: a DisagreementLogWriter::FileHeader, followed by the
+ * name of model 1, the name of model 2 and the file name of the scene
+ * of each world as null-terminated strings, padded to a multiple of 8
+ * bytes. After this, the records follow.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class DisagreementLogWriter
+{
+  public: typedef std::shared_ptr<DisagreementLogWriter> Ptr;
+  public: typedef std::shared_ptr<const DisagreementLogWriter> ConstPtr;
+
+  /// Header at the start of a log file
+  public: struct FileHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t numWorlds;
+    // size of the header including the strings, which is the
+    // offset of the first record
+    uint64_t headerSize;
+    // size of a record including the world summaries
+    uint64_t recordSize;
+  };
+
+  public: DisagreementLogWriter();
+  public: ~DisagreementLogWriter();
+
+  /// Opens the log file \e filename.
+  /// \param[in] model1 name of the stationary model
+  /// \param[in] model2 name of the moving model
+  /// \param[in] sceneFiles the world file which contains the scene for
+  ///   each world, relative to the directory of the log file.
+  /// \param[in] append if true and the file is a log with the same models
+  ///   and number of worlds, new records are appended to it.
+  ///   Otherwise, the file is overwritten.
+  /// \return false if the file could not be opened
+  public: bool Open(const std::string& filename,
+                    const std::string& model1,
+                    const std::string& model2,
+                    const std::vector<std::string>& sceneFiles,
+                    const bool append = false);
+
+  /// Closes the log file
+  public: void Close();
+
+  /// Appends a record. \e worlds must have one entry for each world.
+  /// The record is flushed to the file right away, so that it is not
+  /// lost if the process is killed.
+  /// \return false if the log is not open or the record could not be
+  ///   written.
+  public: bool Write(const DisagreementRecord& record,
+                     const std::vector<DisagreementWorldSummary>& worlds);
+
+  /// \return true if the log is open
+  public: bool IsOpen() const { return file != NULL; }
+
+  /// Creates a record with the state of the moving model
+  public: static DisagreementRecord CreateRecord(const unsigned int failure,
+                                                 const uint64_t cell,
+                                                 const BasicState& state);
+
+  /// Magic bytes at the start of each log file
+  public: static const char Magic[8];
+  /// Version of the file format
+  public: static const uint32_t Version;
+
+  private: FILE * file;
+  private: unsigned int numWorlds;
+};
+
+/**
+ * \brief Reads a log written with DisagreementLogWriter.
+ *
+ * The file is memory-mapped, so that records can be accessed without
+ * reading the whole file.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class DisagreementLogReader
+{
+  public: typedef std::shared_ptr<DisagreementLogReader> Ptr;
+  public: typedef std::shared_ptr<const DisagreementLogReader> ConstPtr;
+
+  public: DisagreementLogReader();
+  public: ~DisagreementLogReader();
+
+  /// Opens and maps the log file \e filename
+  /// \return false if the file could not be opened or is no valid log
+  public: bool Open(const std::string& filename);
+
+  /// Unmaps the log file
+  public: void Close();
+
+  /// \return number of complete records in the log
+  public: uint64_t GetNumRecords() const { return numRecords; }
+
+  /// \return number of worlds per record
+  public: unsigned int GetNumWorlds() const { return sceneFiles.size(); }
+
+  /// \return the record with index \e i < GetNumRecords()
+  public: const DisagreementRecord& GetRecord(const uint64_t i) const;
+
+  /// \return the summary of world \e w < GetNumWorlds() in the record
+  ///   with index \e i < GetNumRecords()
+  public: const DisagreementWorldSummary&
+          GetWorldSummary(const uint64_t i, const unsigned int w) const;
+
+  /// \return name of the stationary model
+  public: const std::string& GetModel1() const { return model1; }
+
+  /// \return name of the moving model
+  public: const std::string& GetModel2() const { return model2; }
+
+  /// \return file name of the scene of world \e w, relative to the
+  ///   directory of the log file
+  public: const std::string& GetSceneFile(const unsigned int w) const
+          { return sceneFiles[w]; }
+
+  // memory-mapped file
+  private: const char * data;
+  private: size_t size;
+  private: uint64_t headerSize;
+  private: uint64_t recordSize;
+  private: uint64_t numRecords;
+  private: std::string model1;
+  private: std::string model2;
+  private: std::vector<std::string> sceneFiles;
+};
+
+}  // namespace collision_benchmark
+#endif  // COLLISION_BENCHMARK_DISAGREEMENTLOG_H
@@ -26,6 +26,7 @@
 #include <collision_benchmark/GazeboHelpers.hh>
 #include <collision_benchmark/GazeboWorldLoader.hh>
 #include <collision_benchmark/Helpers.hh>
+#include <collision_benchmark/Trace.hh>
 #include <collision_benchmark/boost_std_conversion.hh>
 
 #include <gazebo/physics/physics.hh>
@@ -33,6 +34,7 @@
 
 #include <boost/filesystem.hpp>
 #include <algorithm>
+#include <unordered_map>
 
 using collision_benchmark::GazeboPhysicsWorld;
 using collision_benchmark::Contact;
@@ -40,7 +42,9 @@ using collision_benchmark::ContactInfo;
 
 GazeboPhysicsWorld::GazeboPhysicsWorld(bool _enforceContactComputation)
   : enforceContactComputation(_enforceContactComputation),
-    paused(false)
+    paused(false),
+    nameTable(new NameTable()),
+    contactPairIndexValid(false)
 {
 }
 
@@ -506,24 +510,136 @@ GazeboPhysicsWorld::GetAllModelIDs() const
   return names;
 }
 
+GazeboPhysicsWorld::ModelHandle
+GazeboPhysicsWorld::GetModelHandle(const ModelID& id) const
+{
+  std::lock_guard<std::mutex> lock(modelSlotsMutex);
+  ModelHandle handle;
+  std::unordered_map<std::string, int>::const_iterator it =
+    modelSlotByName.find(id);
+  if (it != modelSlotByName.end())
+  {
+    if (!modelSlots[it->second].model.expired())
+    {
+      handle.slot = it->second;
+      handle.generation = modelSlots[handle.slot].generation;
+      return handle;
+    }
+    FreeModelSlotNoLock(it->second);
+  }
+
+  // first request for this model: this is the only
+  // place where the model has to be searched by name.
+  gazebo::physics::ModelPtr m = world->ModelByName(id);
+  if (!m) return handle;
+
+  if (!freeModelSlots.empty())
+  {
+    handle.slot = freeModelSlots.back();
+    freeModelSlots.pop_back();
+  }
+  else
+  {
+    handle.slot = modelSlots.size();
+    modelSlots.push_back(ModelSlot());
+  }
+  ModelSlot& slot = modelSlots[handle.slot];
+  slot.model = m;
+  slot.name = id;
+  handle.generation = slot.generation;
+  modelSlotByName[id] = handle.slot;
+  return handle;
+}
+
+bool GazeboPhysicsWorld::IsValid(const ModelHandle& handle) const
+{
+  return ResolveModelHandle(handle).get() != NULL;
+}
+
+gazebo::physics::ModelPtr
+GazeboPhysicsWorld::ResolveModelHandleNoLock(const ModelHandle& handle) const
+{
+  if (handle.slot < 0 ||
+      static_cast<size_t>(handle.slot) >= modelSlots.size())
+    return gazebo::physics::ModelPtr();
+  const ModelSlot& slot = modelSlots[handle.slot];
+  if (slot.generation != handle.generation)
+    return gazebo::physics::ModelPtr();
+  gazebo::physics::ModelPtr m = slot.model.lock();
+  if (!m) FreeModelSlotNoLock(handle.slot);
+  return m;
+}
+
+gazebo::physics::ModelPtr
+GazeboPhysicsWorld::ResolveModelHandle(const ModelHandle& handle) const
+{
+  std::lock_guard<std::mutex> lock(modelSlotsMutex);
+  return ResolveModelHandleNoLock(handle);
+}
+
+void GazeboPhysicsWorld::FreeModelSlotNoLock(const int idx) const
+{
+  ModelSlot& slot = modelSlots[idx];
+  modelSlotByName.erase(slot.name);
+  slot.model.reset();
+  slot.name.clear();
+  ++slot.generation;
+  freeModelSlots.push_back(idx);
+}
+
+void GazeboPhysicsWorld::InvalidateModelHandles()
+{
+  std::lock_guard<std::mutex> lock(modelSlotsMutex);
+  freeModelSlots.clear();
+  for (int i = modelSlots.size() - 1; i >= 0; --i)
+  {
+    ModelSlot& slot = modelSlots[i];
+    slot.model.reset();
+    slot.name.clear();
+    ++slot.generation;
+    freeModelSlots.push_back(i);
+  }
+  modelSlotByName.clear();
+}
+
 int GazeboPhysicsWorld::GetIntegerModelID(const ModelID& id) const
 {
-  gazebo::physics::ModelPtr m=world->ModelByName(id);
+  return GetIntegerModelID(GetModelHandle(id));
+}
+
+int GazeboPhysicsWorld::GetIntegerModelID(const ModelHandle& handle) const
+{
+  gazebo::physics::ModelPtr m = ResolveModelHandle(handle);
   if (!m) return -1;
   return m->GetId();
 }
 
 bool GazeboPhysicsWorld::RemoveModel(const ModelID& id)
 {
-  gazebo::physics::ModelPtr m=world->ModelByName(id);
-  if (!m) return false;
+  return RemoveModel(GetModelHandle(id));
+}
+
+bool GazeboPhysicsWorld::RemoveModel(const ModelHandle& handle)
+{
+  gazebo::physics::ModelPtr m;
+  {
+    std::lock_guard<std::mutex> lock(modelSlotsMutex);
+    m = ResolveModelHandleNoLock(handle);
+    if (!m) return false;
+    // free the slot, which invalidates all handles to it
+    FreeModelSlotNoLock(handle.slot);
+  }
+  ForgetEntityNames(*m);
   world->RemoveModel(m);
+  InvalidateContactPairIndex();
   return true;
 }
 
 void GazeboPhysicsWorld::Clear()
 {
   collision_benchmark::ClearModels(world);
+  InvalidateModelHandles();
+  ResetContactNames();
 }
 
 GazeboPhysicsWorld::WorldState GazeboPhysicsWorld::GetWorldState() const
@@ -543,7 +659,18 @@ GazeboPhysicsWorld::GetWorldStateDiff(const WorldState& other) const
 collision_benchmark::OpResult
 GazeboPhysicsWorld::SetWorldState(const WorldState& state, bool isDiff)
 {
-  collision_benchmark::SetWorldState(world, state);
+  TRACE_WORLD_SCOPE("SetWorldState", GetName());
+  // handles and names only become invalid if models may have been
+  // removed or replaced
+  if (collision_benchmark::SetWorldState(world, state))
+  {
+    InvalidateModelHandles();
+    ResetContactNames();
+  }
+  else
+  {
+    InvalidateContactPairIndex();
+  }
 
 #ifdef DEBUG
   gazebo::physics::WorldState _currentState(world);
@@ -560,16 +687,249 @@ GazeboPhysicsWorld::SetWorldState(const WorldState& state, bool isDiff)
 }
 
 
-bool GazeboPhysicsWorld::SetBasicModelState(const ModelID  &_id,
-                                            const BasicState &_state)
+// helper function which appends the states of the links and joints
+// of \e m and its nested models to \e snapshot
+static void AppendModelSnapshotHelper(const gazebo::physics::ModelPtr& m,
+                                      GazeboPhysicsWorld::Snapshot& snapshot)
 {
-  gazebo::physics::ModelPtr m=world->ModelByName(_id);
-  if (!m)
+  const gazebo::physics::Link_V& links = m->GetLinks();
+  for (gazebo::physics::Link_V::const_iterator it = links.begin();
+       it != links.end(); ++it)
   {
-    std::cerr << "World "<<GetName()<<": Model " << _id
-              << " could not be found" << std::endl;
-    return false;
+    const ignition::math::Pose3d pose = (*it)->WorldPose();
+    const ignition::math::Vector3d linVel = (*it)->WorldLinearVel();
+    const ignition::math::Vector3d angVel = (*it)->WorldAngularVel();
+    const double p[7] = {pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z(),
+                         pose.Rot().W(), pose.Rot().X(), pose.Rot().Y(),
+                         pose.Rot().Z()};
+    const double v[6] = {linVel.X(), linVel.Y(), linVel.Z(),
+                         angVel.X(), angVel.Y(), angVel.Z()};
+    snapshot.linkPoses.insert(snapshot.linkPoses.end(), p, p + 7);
+    snapshot.linkVelocities.insert(snapshot.linkVelocities.end(), v, v + 6);
+  }
+  const gazebo::physics::Joint_V& joints = m->GetJoints();
+  for (gazebo::physics::Joint_V::const_iterator it = joints.begin();
+       it != joints.end(); ++it)
+  {
+    for (unsigned int i = 0; i < (*it)->DOF(); ++i)
+    {
+      snapshot.jointPositions.push_back((*it)->Position(i));
+      snapshot.jointVelocities.push_back((*it)->GetVelocity(i));
+    }
+  }
+  const gazebo::physics::Model_V& nested = m->NestedModels();
+  for (gazebo::physics::Model_V::const_iterator it = nested.begin();
+       it != nested.end(); ++it)
+  {
+    AppendModelSnapshotHelper(*it, snapshot);
+  }
+}
+
+// helper function which counts the links and joint axes
+// of \e m and its nested models
+static void CountModelSnapshotHelper(const gazebo::physics::ModelPtr& m,
+                                     unsigned int& numLinks,
+                                     unsigned int& numJointAxes)
+{
+  numLinks += m->GetLinks().size();
+  const gazebo::physics::Joint_V& joints = m->GetJoints();
+  for (gazebo::physics::Joint_V::const_iterator it = joints.begin();
+       it != joints.end(); ++it)
+  {
+    numJointAxes += (*it)->DOF();
+  }
+  const gazebo::physics::Model_V& nested = m->NestedModels();
+  for (gazebo::physics::Model_V::const_iterator it = nested.begin();
+       it != nested.end(); ++it)
+  {
+    CountModelSnapshotHelper(*it, numLinks, numJointAxes);
+  }
+}
+
+// helper function which sets the links and joints of \e m and its
+// nested models to the state in \e snapshot, starting at link
+// \e linkIdx and joint axis \e jointIdx. Both indices are advanced.
+static void
+RestoreModelSnapshotHelper(const gazebo::physics::ModelPtr& m,
+                           const GazeboPhysicsWorld::Snapshot& snapshot,
+                           unsigned int& linkIdx,
+                           unsigned int& jointIdx)
+{
+  // set the joints first, because setting the joint positions
+  // moves the links, which are set to their exact state after.
+  const gazebo::physics::Joint_V& joints = m->GetJoints();
+  for (gazebo::physics::Joint_V::const_iterator it = joints.begin();
+       it != joints.end(); ++it)
+  {
+    for (unsigned int i = 0; i < (*it)->DOF(); ++i, ++jointIdx)
+    {
+      (*it)->SetPosition(i, snapshot.jointPositions[jointIdx]);
+      (*it)->SetVelocity(i, snapshot.jointVelocities[jointIdx]);
+    }
+  }
+  const gazebo::physics::Link_V& links = m->GetLinks();
+  for (gazebo::physics::Link_V::const_iterator it = links.begin();
+       it != links.end(); ++it, ++linkIdx)
+  {
+    const double * p = &snapshot.linkPoses[7 * linkIdx];
+    const double * v = &snapshot.linkVelocities[6 * linkIdx];
+    (*it)->SetWorldPose(ignition::math::Pose3d(p[0], p[1], p[2],
+                                               p[3], p[4], p[5], p[6]));
+    (*it)->SetLinearVel(ignition::math::Vector3d(v[0], v[1], v[2]));
+    (*it)->SetAngularVel(ignition::math::Vector3d(v[3], v[4], v[5]));
+  }
+  const gazebo::physics::Model_V& nested = m->NestedModels();
+  for (gazebo::physics::Model_V::const_iterator it = nested.begin();
+       it != nested.end(); ++it)
+  {
+    RestoreModelSnapshotHelper(*it, snapshot, linkIdx, jointIdx);
   }
+}
+
+void GazeboPhysicsWorld::GetSnapshot(Snapshot& snapshot) const
+{
+  TRACE_WORLD_SCOPE("GetSnapshot", GetName());
+  // clear() keeps the capacity, so no memory is
+  // allocated when a snapshot instance is re-used
+  snapshot.worldName = GetName();
+  snapshot.simTime = world->SimTime().Double();
+  snapshot.modelNames.clear();
+  snapshot.modelHandles.clear();
+  snapshot.linkOffsets.clear();
+  snapshot.jointOffsets.clear();
+  snapshot.linkPoses.clear();
+  snapshot.linkVelocities.clear();
+  snapshot.jointPositions.clear();
+  snapshot.jointVelocities.clear();
+
+  const gazebo::physics::Model_V models = world->Models();
+  for (gazebo::physics::Model_V::const_iterator it = models.begin();
+       it != models.end(); ++it)
+  {
+    snapshot.modelNames.push_back((*it)->GetName());
+    snapshot.modelHandles.push_back(GetModelHandle((*it)->GetName()));
+    snapshot.linkOffsets.push_back(snapshot.linkPoses.size() / 7);
+    snapshot.jointOffsets.push_back(snapshot.jointPositions.size());
+    AppendModelSnapshotHelper(*it, snapshot);
+  }
+  snapshot.linkOffsets.push_back(snapshot.linkPoses.size() / 7);
+  snapshot.jointOffsets.push_back(snapshot.jointPositions.size());
+}
+
+bool GazeboPhysicsWorld::RestoreSnapshot(const Snapshot& snapshot)
+{
+  TRACE_WORLD_SCOPE("RestoreSnapshot", GetName());
+  const unsigned int numModels = snapshot.modelNames.size();
+  if (world->ModelCount() != numModels) return false;
+
+  // resolve and check all models before anything is changed. The handles
+  // in the snapshot can only be used if it was taken of this world.
+  const bool ownSnapshot = (snapshot.worldName == GetName());
+  std::vector<gazebo::physics::ModelPtr> models(numModels);
+  for (unsigned int i = 0; i < numModels; ++i)
+  {
+    if (ownSnapshot) models[i] = ResolveModelHandle(snapshot.modelHandles[i]);
+    if (!models[i])
+      models[i] = ResolveModelHandle(GetModelHandle(snapshot.modelNames[i]));
+    if (!models[i]) return false;
+
+    unsigned int numLinks = 0;
+    unsigned int numJointAxes = 0;
+    CountModelSnapshotHelper(models[i], numLinks, numJointAxes);
+    if ((numLinks !=
+         snapshot.linkOffsets[i + 1] - snapshot.linkOffsets[i]) ||
+        (numJointAxes !=
+         snapshot.jointOffsets[i + 1] - snapshot.jointOffsets[i]))
+      return false;
+  }
+
+  unsigned int linkIdx = 0;
+  unsigned int jointIdx = 0;
+  for (unsigned int i = 0; i < numModels; ++i)
+  {
+    RestoreModelSnapshotHelper(models[i], snapshot, linkIdx, jointIdx);
+  }
+  world->SetSimTime(gazebo::common::Time(snapshot.simTime));
+  return true;
+}
+
+// helper function which removes all children named \e name from \e elem
+static void RemoveSDFChildrenHelper(const sdf::ElementPtr& elem,
+                                    const std::string& name)
+{
+  while (elem->HasElement(name))
+  {
+    elem->RemoveChild(elem->GetElement(name));
+  }
+}
+
+// helper function which adds a copy of \e child to \e elem
+static void InsertSDFCopyHelper(const sdf::ElementPtr& elem,
+                                const sdf::ElementPtr& child)
+{
+  sdf::ElementPtr copy = child->Clone();
+  copy->SetParent(elem);
+  elem->InsertElement(copy);
+}
+
+std::shared_ptr<GazeboPhysicsWorld>
+GazeboPhysicsWorld::Fork(const std::string& forkName) const
+{
+  TRACE_WORLD_SCOPE("Fork", GetName());
+  std::shared_ptr<GazeboPhysicsWorld> fork;
+  sdf::ElementPtr sdf = world ? world->GetSDF() : sdf::ElementPtr();
+  if (!sdf || !sdf->HasElement("world"))
+  {
+    std::cerr << "Could not get SDF of world to fork" << std::endl;
+    return fork;
+  }
+
+  // copy of the world SDF in which the models and physics settings are
+  // replaced by the current ones. Populations would add the
+  // populated models a second time and the state is copied later.
+  sdf::ElementPtr worldSDF = sdf->GetElement("world")->Clone();
+  RemoveSDFChildrenHelper(worldSDF, "model");
+  RemoveSDFChildrenHelper(worldSDF, "actor");
+  RemoveSDFChildrenHelper(worldSDF, "population");
+  RemoveSDFChildrenHelper(worldSDF, "state");
+  if (world->Physics() && world->Physics()->GetSDF())
+  {
+    RemoveSDFChildrenHelper(worldSDF, "physics");
+    InsertSDFCopyHelper(worldSDF, world->Physics()->GetSDF());
+  }
+  const gazebo::physics::Model_V models = world->Models();
+  for (gazebo::physics::Model_V::const_iterator it = models.begin();
+       it != models.end(); ++it)
+  {
+    InsertSDFCopyHelper(worldSDF, (*it)->GetSDF());
+  }
+
+  fork.reset(new GazeboPhysicsWorld(enforceContactComputation));
+  if (fork->LoadFromSDF(worldSDF, forkName) != collision_benchmark::SUCCESS)
+  {
+    std::cerr << "Could not load fork '" << forkName << "' of world '"
+              << GetName() << "'" << std::endl;
+    return std::shared_ptr<GazeboPhysicsWorld>();
+  }
+
+  Snapshot snapshot;
+  GetSnapshot(snapshot);
+  if (!fork->RestoreSnapshot(snapshot))
+  {
+    std::cerr << "Could not copy the state of world '" << GetName()
+              << "' to its fork '" << forkName << "'" << std::endl;
+    return std::shared_ptr<GazeboPhysicsWorld>();
+  }
+  fork->SetDynamicsEnabled(world->PhysicsEnabled());
+  fork->SetPaused(IsPaused());
+  return fork;
+}
+
+// helper function which sets the state of the model
+static void
+SetBasicModelStateHelper(const gazebo::physics::ModelPtr& m,
+                         const collision_benchmark::BasicState &_state)
+{
   ignition::math::Pose3d pose = m->WorldPose();
   if (_state.PosEnabled()) pose.Pos().Set(_state.position.x,
                                           _state.position.y,
@@ -590,19 +950,98 @@ bool GazeboPhysicsWorld::SetBasicModelState(const ModelID  &_id,
                                _state.scale.z);
     m->SetScale(s);
   }
+}
+
+bool GazeboPhysicsWorld::SetBasicModelState(const ModelID  &_id,
+                                            const BasicState &_state)
+{
+  ModelHandle handle = GetModelHandle(_id);
+  if (handle.IsNull())
+  {
+    std::cerr << "World "<<GetName()<<": Model " << _id
+              << " could not be found" << std::endl;
+    return false;
+  }
+  return SetBasicModelState(handle, _state);
+}
+
+bool GazeboPhysicsWorld::SetBasicModelState(const ModelHandle &_handle,
+                                            const BasicState &_state)
+{
+  gazebo::physics::ModelPtr m = ResolveModelHandle(_handle);
+  if (!m)
+  {
+    std::cerr << "World "<<GetName()<<": Invalid model handle" << std::endl;
+    return false;
+  }
+  SetBasicModelStateHelper(m, _state);
   return true;
 }
 
+int GazeboPhysicsWorld::SetBasicModelStates
+    (const std::vector<std::pair<ModelID, BasicState>>& _states)
+{
+  std::vector<std::pair<ModelHandle, BasicState>> handleStates;
+  handleStates.reserve(_states.size());
+  for (std::vector<std::pair<ModelID, BasicState>>::const_iterator
+       it = _states.begin(); it != _states.end(); ++it)
+  {
+    ModelHandle handle = GetModelHandle(it->first);
+    if (handle.IsNull())
+    {
+      std::cerr << "World "<<GetName()<<": Model " << it->first
+                << " could not be found" << std::endl;
+      continue;
+    }
+    handleStates.push_back(std::make_pair(handle, it->second));
+  }
+  return SetBasicModelStates(handleStates);
+}
+
+int GazeboPhysicsWorld::SetBasicModelStates
+    (const std::vector<std::pair<ModelHandle, BasicState>>& _states)
+{
+  int cnt = 0;
+  // resolve all handles under one lock
+  std::lock_guard<std::mutex> lock(modelSlotsMutex);
+  for (std::vector<std::pair<ModelHandle, BasicState>>::const_iterator
+       it = _states.begin(); it != _states.end(); ++it)
+  {
+    gazebo::physics::ModelPtr m = ResolveModelHandleNoLock(it->first);
+    if (!m)
+    {
+      std::cerr << "World "<<GetName()<<": Invalid model handle" << std::endl;
+      continue;
+    }
+    SetBasicModelStateHelper(m, it->second);
+    ++cnt;
+  }
+  return cnt;
+}
+
 bool GazeboPhysicsWorld::GetBasicModelState(const ModelID  &_id,
                                             BasicState &_state)
 {
-  gazebo::physics::ModelPtr m=world->ModelByName(_id);
-  if (!m)
+  ModelHandle handle = GetModelHandle(_id);
+  if (handle.IsNull())
   {
     std::cerr << "World " << GetName() << ": Model " << _id
               << " could not be found" << std::endl;
     return false;
   }
+  return GetBasicModelState(handle, _state);
+}
+
+bool GazeboPhysicsWorld::GetBasicModelState(const ModelHandle &_handle,
+                                            BasicState &_state) const
+{
+  gazebo::physics::ModelPtr m = ResolveModelHandle(_handle);
+  if (!m)
+  {
+    std::cerr << "World " << GetName() << ": Invalid model handle"
+              << std::endl;
+    return false;
+  }
   ignition::math::Pose3d pose = m->WorldPose();
   _state.SetPosition(pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z());
   _state.SetRotation(pose.Rot().X(), pose.Rot().Y(),
@@ -632,6 +1071,7 @@ void GazeboPhysicsWorld::PostWorldLoaded()
 
 void GazeboPhysicsWorld::Update(int steps, bool force)
 {
+  InvalidateContactPairIndex();
   // std::cout<<"Running "<<steps<<" steps for world "
   //          <<world->Name()<<", physics engine: "
   //          <<world->Physics()->GetType()<<std::endl;
@@ -697,20 +1137,172 @@ bool GazeboPhysicsWorld::SupportsContacts() const
   return true;
 }
 
-// helper function which can be used to get contact info of either
-// all models (m1 and m2 set to NULL), or for one model
-// (m1=NULL and m2=NULL) or for two models (m1!=NULL and m2!=NULL).
-std::vector<GazeboPhysicsWorld::ContactInfoPtr>
-GetContactInfoHelper(const gazebo::physics::WorldPtr& world,
-                     const GazeboPhysicsWorld::ModelID * m1=NULL,
-                     const GazeboPhysicsWorld::ModelID * m2=NULL)
+int GazeboPhysicsWorld::GetEntityNameIdNoLock
+  (const gazebo::physics::Base& entity) const
 {
-  std::vector<GazeboPhysicsWorld::ContactInfoPtr> ret;
+  std::unordered_map<uint32_t, int>::const_iterator it =
+    entityNameIds.find(entity.GetId());
+  if (it != entityNameIds.end()) return it->second;
+  int id;
+  {
+    // the contact buffers may look up names at the same time
+    std::lock_guard<std::mutex> lock(nameTable->mutex);
+    id = nameTable->names.Intern(entity.GetName());
+  }
+  entityNameIds[entity.GetId()] = id;
+  return id;
+}
+
+void GazeboPhysicsWorld::ForgetEntityNames
+  (const gazebo::physics::Model& model)
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  entityNameIds.erase(model.GetId());
+  const gazebo::physics::Link_V& links = model.GetLinks();
+  for (gazebo::physics::Link_V::const_iterator it = links.begin();
+       it != links.end(); ++it)
+  {
+    entityNameIds.erase((*it)->GetId());
+  }
+}
+
+void GazeboPhysicsWorld::ResetContactNames()
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  nameTable.reset(new NameTable());
+  entityNameIds.clear();
+  contactPairIndex.clear();
+  contactPairIndexValid = false;
+}
+
+std::string GazeboPhysicsWorld::GetInternedName(const int id) const
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  return nameTable->names.GetString(id);
+}
+
+int GazeboPhysicsWorld::GetInternedId(const std::string& name) const
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  return nameTable->names.Find(name);
+}
+
+// helper function which returns true if the contact between the models
+// with interned IDs \e c1Id and \e c2Id should be skipped, given
+// the interned IDs \e m1Id and \e m2Id of the requested models (-1 if
+// not requested): either all models (m1Id and m2Id are -1), or for one
+// model (m1Id != -1 and m2Id = -1) or for two models (both not -1).
+static bool SkipContactHelper(const int m1Id, const int m2Id,
+                              const int c1Id, const int c2Id)
+{
+  if (m1Id < 0) return false;
+  if (m2Id >= 0)
+  { // c1Id and c2Id do not correspond to m1Id and m2Id
+    return (m1Id != c1Id || m2Id != c2Id) &&
+           (m1Id != c2Id || m2Id != c1Id);
+  }
+  // m1Id has to be c1Id or c2Id to continue
+  return m1Id != c1Id && m1Id != c2Id;
+}
+
+static uint64_t ContactPairKey(const int m1Id, const int m2Id)
+{
+  // the pair is unordered, so always put the smaller ID first
+  uint32_t first = std::min(m1Id, m2Id);
+  uint32_t second = std::max(m1Id, m2Id);
+  return (static_cast<uint64_t>(first) << 32) | second;
+}
+
+void GazeboPhysicsWorld::InvalidateContactPairIndex()
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  contactPairIndexValid = false;
+}
+
+void GazeboPhysicsWorld::UpdateContactPairIndexNoLock() const
+{
+  if (contactPairIndexValid) return;
+  for (std::unordered_map<uint64_t, std::vector<unsigned int>>::iterator
+       it = contactPairIndex.begin(); it != contactPairIndex.end(); ++it)
+  {
+    it->second.clear();
+  }
+  const gazebo::physics::ContactManager* contactManager =
+    world->Physics()->GetContactManager();
+  GZ_ASSERT(contactManager, "Contact manager has to be set");
+  const std::vector<gazebo::physics::Contact*>& contacts =
+    contactManager->GetContacts();
+  unsigned int count = std::min(static_cast<size_t>
+                                (contactManager->GetContactCount()),
+                                contacts.size());
+  for (unsigned int cIdx = 0; cIdx < count; ++cIdx)
+  {
+    const gazebo::physics::Contact * c = contacts[cIdx];
+    const gazebo::physics::ModelPtr model1 = c->collision1->GetModel();
+    const gazebo::physics::ModelPtr model2 = c->collision2->GetModel();
+    GZ_ASSERT(model1, "Model of collision1 must be set");
+    GZ_ASSERT(model2, "Model of collision2 must be set");
+    contactPairIndex[ContactPairKey(GetEntityNameIdNoLock(*model1),
+                                    GetEntityNameIdNoLock(*model2))]
+      .push_back(cIdx);
+  }
+  contactPairIndexValid = true;
+}
+
+const std::vector<unsigned int> *
+GazeboPhysicsWorld::GetPairContactsNoLock(const int m1Id,
+                                          const int m2Id) const
+{
+  UpdateContactPairIndexNoLock();
+  std::unordered_map<uint64_t, std::vector<unsigned int>>::const_iterator
+    it = contactPairIndex.find(ContactPairKey(m1Id, m2Id));
+  if (it == contactPairIndex.end() || it->second.empty()) return NULL;
+  return &(it->second);
+}
+
+void GazeboPhysicsWorld::FillContactBufferHelper(ContactBuffer& buffer,
+                                                 const ModelID * m1,
+                                                 const ModelID * m2) const
+{
+  buffer.Clear();
   const gazebo::physics::ContactManager* contactManager =
     world->Physics()->GetContactManager();
   GZ_ASSERT(contactManager, "Contact manager has to be set");
   const std::vector<gazebo::physics::Contact*>& contacts =
     contactManager->GetContacts();
+
+  std::lock_guard<std::mutex> lock(namesMutex);
+  buffer.SetNameResolver(nameTable);
+  int m1Id = -1;
+  int m2Id = -1;
+  if (m1)
+  {
+    // a model which is not interned after the contacts have been
+    // indexed is not in contact
+    UpdateContactPairIndexNoLock();
+    m1Id = nameTable->names.Find(*m1);
+    if (m1Id < 0) return;
+    if (m2)
+    {
+      m2Id = nameTable->names.Find(*m2);
+      if (m2Id < 0) return;
+    }
+  }
+
+  if (m1 && m2)
+  {
+    // only look at the contacts of this pair
+    const std::vector<unsigned int> * pairContacts =
+      GetPairContactsNoLock(m1Id, m2Id);
+    if (!pairContacts) return;
+    for (std::vector<unsigned int>::const_iterator
+         it = pairContacts->begin(); it != pairContacts->end(); ++it)
+    {
+      AddContactNoLock(*contacts[*it], buffer);
+    }
+    return;
+  }
+
   // std::cout<<"World has "<<contacts.size()<<"contacts."<<std::endl;
   for (int cIdx = 0; cIdx < contactManager->GetContactCount(); ++cIdx)
   {
@@ -720,94 +1312,130 @@ GetContactInfoHelper(const gazebo::physics::WorldPtr& world,
                       << cIdx << ", size = " << contacts.size());
     }
     const gazebo::physics::Contact * c = contacts[cIdx];
-    GZ_ASSERT(c->collision1->GetModel(), "Model of collision1 must be set");
-    GZ_ASSERT(c->collision1->GetLink(), "Link of collision1 must be set");
-    GZ_ASSERT(c->collision2->GetModel(), "Model of collision2 must be set");
-    GZ_ASSERT(c->collision2->GetLink(), "Link of collision2 must be set");
-
-    std::string m1Name=c->collision1->GetModel()->GetName();
-    std::string m2Name=c->collision2->GetModel()->GetName();
-
     if (m1)
     {
-      if (m2)
-      { // m1Name and m2Name do not correspond to m1 and m2
-        if ((*m1!=m1Name || *m2!=m2Name) &&
-            (*m1!=m2Name || *m2!=m1Name)) continue;
-      }
-      else
-      { // m1 has to be m1Name or m2Name to continue
-        if (*m1!=m1Name && *m1!=m2Name) continue;
-      }
+      const gazebo::physics::ModelPtr model1 = c->collision1->GetModel();
+      const gazebo::physics::ModelPtr model2 = c->collision2->GetModel();
+      GZ_ASSERT(model1, "Model of collision1 must be set");
+      GZ_ASSERT(model2, "Model of collision2 must be set");
+      if (SkipContactHelper(m1Id, m2Id, GetEntityNameIdNoLock(*model1),
+                            GetEntityNameIdNoLock(*model2))) continue;
     }
+    AddContactNoLock(*c, buffer);
+  }
+}
+
+// negative contact depths are considered invalid if they are
+// further beyond 0 than this
+static const double negativeDepthTol = 1e-03;
 
-    if (c->count == 0)
+// returns true if \e c has at least one contact point with a valid depth
+static bool HasValidContactPoint(const gazebo::physics::Contact& c)
+{
+  for (int i=0; i < c.count; ++i)
+  {
+    if (c.depths[i] >= -negativeDepthTol) return true;
+  }
+  return false;
+}
+
+void GazeboPhysicsWorld::AddContactNoLock(const gazebo::physics::Contact& c,
+                                          ContactBuffer& buffer) const
+{
+  const gazebo::physics::ModelPtr model1 = c.collision1->GetModel();
+  const gazebo::physics::ModelPtr model2 = c.collision2->GetModel();
+  GZ_ASSERT(model1, "Model of collision1 must be set");
+  GZ_ASSERT(c.collision1->GetLink(), "Link of collision1 must be set");
+  GZ_ASSERT(model2, "Model of collision2 must be set");
+  GZ_ASSERT(c.collision2->GetLink(), "Link of collision2 must be set");
+
+  int c1Id = GetEntityNameIdNoLock(*model1);
+  int c2Id = GetEntityNameIdNoLock(*model2);
+  // as in ContactInfo, the model with the lexicographically 'smaller'
+  // name comes first. This has to be compared before the next name is
+  // interned, which invalidates the references.
+  const bool swapModels =
+    nameTable->names.GetString(c2Id) < nameTable->names.GetString(c1Id);
+
+  if (c.count == 0)
+  {
+    // for BULLET, it can happen quite frequently that a contact is given
+    // while there is no actual contact information.
+    // See also this issue:
+    // https://bitbucket.org/osrf/gazebo/issues/2222/bullet-contact-points-with-positive
+    // For now, don't print this warning for bullet.
+    if (world->Physics()->GetType() != "bullet")
     {
-      // for BULLET, it can happen quite frequently that a contact is given
-      // while there is no actual contact information.
-      // See also this issue:
-      // https://bitbucket.org/osrf/gazebo/issues/2222/bullet-contact-points-with-positive
-      // For now, don't print this warning for bullet.
-      if (world->Physics()->GetType() != "bullet")
-      {
-        std::cerr << "CONSISTENCY GazeboPhysicsWorld: With no contacts, "
-                  << "there should be no collision!! World: " << world->Name()
-                  << " Models: " << m1Name << ", " << m2Name << std::endl;
-      }
-      continue;
+      std::cerr << "CONSISTENCY GazeboPhysicsWorld: With no contacts, "
+                << "there should be no collision!! World: " << world->Name()
+                << " Models: " << nameTable->names.GetString(c1Id) << ", "
+                << nameTable->names.GetString(c2Id) << std::endl;
     }
+    return;
+  }
 
-    GazeboPhysicsWorld::ContactInfoPtr
-      cInfo(new GazeboPhysicsWorld::ContactInfo
-            (m1Name, c->collision1->GetLink()->GetName(),
-             m2Name, c->collision2->GetLink()->GetName()));
-    for (int i=0; i < c->count; ++i)
+  int link1Id = GetEntityNameIdNoLock(*c.collision1->GetLink());
+  int link2Id = GetEntityNameIdNoLock(*c.collision2->GetLink());
+  unsigned int pairIdx = swapModels ?
+    buffer.AddPair(c2Id, link2Id, c1Id, link1Id) :
+    buffer.AddPair(c1Id, link1Id, c2Id, link2Id);
+  for (int i=0; i < c.count; ++i)
+  {
+    if (c.depths[i] < 0)
     {
-      if (c->depths[i] < 0)
+      // negative depths shoudl be considered invalid if they
+      // are far beyond 0
+      if (c.depths[i] < -negativeDepthTol)
       {
-        // negative depths shoudl be considered invalid if they
-        // are far beyond 0
-        static double tol = 1e-03;
-        if (c->depths[i] < -tol)
-        {
-          std::cout << "DEBUG-INFO: Negative contact distance found in world "
-                    << world->Name() <<", depth = " << c->depths[i]
-                    << ". Skipping contact. " << std::endl;
-          continue;
-        }
+        std::cout << "DEBUG-INFO: Negative contact distance found in world "
+                  << world->Name() <<", depth = " << c.depths[i]
+                  << ". Skipping contact. " << std::endl;
+        continue;
       }
-      cInfo->contacts.push_back
-        (GazeboPhysicsWorld::Contact(c->positions[i], c->normals[i],
-                                     c->wrench[i], c->depths[i]));
     }
+    buffer.AddContact(c.positions[i], c.normals[i],
+                      c.wrench[i], c.depths[i]);
+  }
 
-    if (cInfo->contacts.empty())
-    {
-     std::cout << "WARNING: All contact points gotten from models "
-               << m1Name << " / " << c->collision1->GetLink()->GetName() << ", "
-               << m2Name << " / " << c->collision2->GetLink()->GetName()
-               << " world " << world->Name() <<" skipped. " << std::endl;
-    }
-    else
-    {
-      ret.push_back(cInfo);
-    }
+  if (buffer.GetPair(pairIdx).numContacts == 0)
+  {
+   std::cout << "WARNING: All contact points gotten from models "
+             << nameTable->names.GetString(c1Id) << " / "
+             << nameTable->names.GetString(link1Id) << ", "
+             << nameTable->names.GetString(c2Id) << " / "
+             << nameTable->names.GetString(link2Id)
+             << " world " << world->Name() <<" skipped. " << std::endl;
+   buffer.RemoveLastPair();
+  }
+}
+
+std::vector<GazeboPhysicsWorld::ContactInfoPtr>
+GazeboPhysicsWorld::GetContactInfoHelper(const ModelID * m1,
+                                         const ModelID * m2) const
+{
+  TRACE_WORLD_SCOPE("GetContactInfo", GetName());
+  // the buffer is re-used between calls so that only the returned
+  // ContactInfo instances are allocated, as when they were built directly
+  std::lock_guard<std::mutex> lock(contactInfoMutex);
+  FillContactBufferHelper(contactInfoBuffer, m1, m2);
+  std::vector<GazeboPhysicsWorld::ContactInfoPtr> ret;
+  ret.reserve(contactInfoBuffer.GetNumPairs());
+  for (unsigned int i = 0; i < contactInfoBuffer.GetNumPairs(); ++i)
+  {
+    ret.push_back(contactInfoBuffer.GetContactInfo(i));
   }
   return ret;
 }
 
+
 // deleter which does nothing, to be used for
 // std::shared_ptr with extreme caution!
 template<typename Type>
 void null_deleter(Type *){}
 
-// helper function which can be used to get contact info of either
-// all models (m1 and m2 set to NULL), or for one model
-// (m1=NULL and m2=NULL) or for two models (m1!=NULL and m2!=NULL).
 std::vector<GazeboPhysicsWorld::NativeContactPtr>
-GetNativeContactsHelper(const gazebo::physics::WorldPtr& world,
-                        const GazeboPhysicsWorld::ModelID * m1=NULL,
-                        const GazeboPhysicsWorld::ModelID * m2=NULL)
+GazeboPhysicsWorld::GetNativeContactsHelper(const ModelID * m1,
+                                            const ModelID * m2) const
 {
   std::vector<GazeboPhysicsWorld::NativeContactPtr> ret;
 
@@ -816,39 +1444,63 @@ GetNativeContactsHelper(const gazebo::physics::WorldPtr& world,
   GZ_ASSERT(contactManager, "Contact manager has to be set");
   const std::vector<gazebo::physics::Contact*>& contacts =
     contactManager->GetContacts();
+
+  std::lock_guard<std::mutex> lock(namesMutex);
+  int m1Id = -1;
+  int m2Id = -1;
+  if (m1)
+  {
+    // a model which is not interned after the contacts have been
+    // indexed is not in contact
+    UpdateContactPairIndexNoLock();
+    m1Id = nameTable->names.Find(*m1);
+    if (m1Id < 0) return ret;
+    if (m2)
+    {
+      m2Id = nameTable->names.Find(*m2);
+      if (m2Id < 0) return ret;
+    }
+  }
+
+  // XXX HACK -> Also remove warning in header documentation of
+  // GetNativeContacts() when this is resolved!
+  // While Gazebo doesn't manage contacts as shared pointers, unfortunately
+  // we will need to return the std::shared_ptr<gazebo::physics::Contact>
+  // pointers without deleter. This may lead to awful segfaults if the
+  // contacts are used beyond their lifetime in Gazebo.
+  // However it is expected (?) that soon Gazebo will use shared pointers
+  // for this as well, so keep this flakey solution for now.
+
+  if (m1 && m2)
+  {
+    // only look at the contacts of this pair
+    const std::vector<unsigned int> * pairContacts =
+      GetPairContactsNoLock(m1Id, m2Id);
+    if (!pairContacts) return ret;
+    for (std::vector<unsigned int>::const_iterator
+         it = pairContacts->begin(); it != pairContacts->end(); ++it)
+    {
+      GazeboPhysicsWorld::NativeContactPtr
+        gzContact(contacts[*it],
+                  &null_deleter<GazeboPhysicsWorld::NativeContact>);
+      ret.push_back(gzContact);
+    }
+    return ret;
+  }
+
   for (std::vector<gazebo::physics::Contact*>::const_iterator
        it=contacts.begin(); it!=contacts.end(); ++it)
   {
       gazebo::physics::Contact * c=*it;
-      GZ_ASSERT(c->collision1->GetModel(), "Model of collision1 must be set");
-      GZ_ASSERT(c->collision1->GetLink(), "Link of collision1 must be set");
-      GZ_ASSERT(c->collision2->GetModel(), "Model of collision2 must be set");
-      GZ_ASSERT(c->collision2->GetLink(), "Link of collision2 must be set");
-
-      std::string m1Name=c->collision1->GetModel()->GetName();
-      std::string m2Name=c->collision2->GetModel()->GetName();
-
       if (m1)
       {
-        if (m2)
-        { // m1Name and m2Name do not correspond to m1 and m2
-          if ((*m1!=m1Name || *m2!=m2Name) &&
-              (*m1!=m2Name || *m2!=m1Name)) continue;
-        }
-        else
-        { // m1 has to be m1Name or m2Name to continue
-          if (*m1!=m1Name && *m1!=m2Name) continue;
-        }
+        const gazebo::physics::ModelPtr model1 = c->collision1->GetModel();
+        const gazebo::physics::ModelPtr model2 = c->collision2->GetModel();
+        GZ_ASSERT(model1, "Model of collision1 must be set");
+        GZ_ASSERT(model2, "Model of collision2 must be set");
+        if (SkipContactHelper(m1Id, m2Id, GetEntityNameIdNoLock(*model1),
+                              GetEntityNameIdNoLock(*model2))) continue;
       }
-
-      // XXX HACK -> Also remove warning in header documentation of
-      // GetNativeContacts() when this is resolved!
-      // While Gazebo doesn't manage contacts as shared pointers, unfortunately
-      // we will need to return the std::shared_ptr<gazebo::physics::Contact>
-      // pointers without deleter. This may lead to awful segfaults if the
-      // contacts are used beyond their lifetime in Gazebo.
-      // However it is expected (?) that soon Gazebo will use shared pointers
-      // for this as well, so keep this flakey solution for now.
       GazeboPhysicsWorld::NativeContactPtr
         gzContact(c, &null_deleter<GazeboPhysicsWorld::NativeContact>);
       ret.push_back(gzContact);
@@ -860,26 +1512,64 @@ GetNativeContactsHelper(const gazebo::physics::WorldPtr& world,
 std::vector<GazeboPhysicsWorld::ContactInfoPtr>
 GazeboPhysicsWorld::GetContactInfo() const
 {
-  return GetContactInfoHelper(world);
+  return GetContactInfoHelper();
 }
 
 std::vector<GazeboPhysicsWorld::ContactInfoPtr>
 GazeboPhysicsWorld::GetContactInfo(const ModelID& m1, const ModelID& m2) const
 {
-  return GetContactInfoHelper(world, &m1, &m2);
+  return GetContactInfoHelper(&m1, &m2);
+}
+
+void GazeboPhysicsWorld::FillContactBuffer(ContactBuffer& buffer) const
+{
+  FillContactBufferHelper(buffer);
+}
+
+void GazeboPhysicsWorld::FillContactBuffer(const ModelID& m1,
+                                           const ModelID& m2,
+                                           ContactBuffer& buffer) const
+{
+  FillContactBufferHelper(buffer, &m1, &m2);
+}
+
+bool GazeboPhysicsWorld::HasContacts(const ModelID& m1,
+                                     const ModelID& m2) const
+{
+  const gazebo::physics::ContactManager* contactManager =
+    world->Physics()->GetContactManager();
+  GZ_ASSERT(contactManager, "Contact manager has to be set");
+  const std::vector<gazebo::physics::Contact*>& contacts =
+    contactManager->GetContacts();
+
+  std::lock_guard<std::mutex> lock(namesMutex);
+  UpdateContactPairIndexNoLock();
+  const int m1Id = nameTable->names.Find(m1);
+  const int m2Id = nameTable->names.Find(m2);
+  if (m1Id < 0 || m2Id < 0) return false;
+  const std::vector<unsigned int> * pairContacts =
+    GetPairContactsNoLock(m1Id, m2Id);
+  if (!pairContacts) return false;
+  // same criteria as in AddContactNoLock(), without copying the contacts
+  for (std::vector<unsigned int>::const_iterator
+       it = pairContacts->begin(); it != pairContacts->end(); ++it)
+  {
+    if (HasValidContactPoint(*contacts[*it])) return true;
+  }
+  return false;
 }
 
 std::vector<GazeboPhysicsWorld::NativeContactPtr>
 GazeboPhysicsWorld::GetNativeContacts() const
 {
-  return GetNativeContactsHelper(world);
+  return GetNativeContactsHelper();
 }
 
 std::vector<GazeboPhysicsWorld::NativeContactPtr>
 GazeboPhysicsWorld::GetNativeContacts(const ModelID& m1,
                                       const ModelID& m2) const
 {
-  return GetNativeContactsHelper(world, &m1, &m2);
+  return GetNativeContactsHelper(&m1, &m2);
 }
 
 
@@ -922,6 +1612,8 @@ void GazeboPhysicsWorld::SetEnforceContactsComputation(bool flag)
 collision_benchmark::RefResult
 GazeboPhysicsWorld::SetWorld(const WorldPtr& _world)
 {
+  InvalidateModelHandles();
+  ResetContactNames();
   world = collision_benchmark::to_boost_ptr<World>(_world);
   SetEnforceContactsComputation(enforceContactComputation);
   PostWorldLoaded();
@@ -936,7 +1628,13 @@ GazeboPhysicsWorld::WorldPtr GazeboPhysicsWorld::GetWorld() const
 GazeboPhysicsWorld::ModelPtr
 GazeboPhysicsWorld::GetModel(const ModelID& model) const
 {
-  gazebo::physics::ModelPtr m=world->ModelByName(model);
+  return GetModel(GetModelHandle(model));
+}
+
+GazeboPhysicsWorld::ModelPtr
+GazeboPhysicsWorld::GetModel(const ModelHandle& handle) const
+{
+  gazebo::physics::ModelPtr m = ResolveModelHandle(handle);
   return collision_benchmark::to_std_ptr<gazebo::physics::Model>(m);
 }
 
@@ -944,7 +1642,13 @@ GazeboPhysicsWorld::GetModel(const ModelID& model) const
 bool GazeboPhysicsWorld::GetAABB(const ModelID& id,
                                  Vector3& min, Vector3& max) const
 {
-  gazebo::physics::ModelPtr m=world->ModelByName(id);
+  return GetAABB(GetModelHandle(id), min, max);
+}
+
+bool GazeboPhysicsWorld::GetAABB(const ModelHandle& handle,
+                                 Vector3& min, Vector3& max) const
+{
+  gazebo::physics::ModelPtr m = ResolveModelHandle(handle);
   if (!m) return false;
   ignition::math::Box box = m->BoundingBox();
   min = Vector3(box.Min().X(), box.Min().Y(), box.Min().Z());
@@ -2,10 +2,21 @@
 #define COLLISION_BENCHMARK_GAZEBOPHYSICSWORLD
 
 #include <collision_benchmark/PhysicsWorld.hh>
+#include <collision_benchmark/StringInterner.hh>
 #include <gazebo/physics/PhysicsTypes.hh>
 #include <gazebo/physics/World.hh>
 #include <gazebo/physics/Contact.hh>
 
+#include <boost/weak_ptr.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #ifndef CONTACTS_ENFORCABLE
 //#include <gazebo/msgs/MessageTypes.hh>
 #include <gazebo/transport/TransportTypes.hh>
@@ -55,11 +66,17 @@ class GazeboPhysicsWorld:
                                         GazeboPhysicsEngineWorldTypes>
                                           ParentClass;
 
+  // the pointer types of the parent class would not give access
+  // to the methods specific to this class
+  public: typedef std::shared_ptr<GazeboPhysicsWorld> Ptr;
+  public: typedef std::shared_ptr<const GazeboPhysicsWorld> ConstPtr;
+
   public: typedef typename ParentClass::ModelID ModelID;
   public: typedef typename ParentClass::ModelPartID ModelPartID;
   public: typedef typename ParentClass::WorldState WorldState;
   public: typedef typename ParentClass::ContactInfo ContactInfo;
   public: typedef typename ParentClass::ContactInfoPtr ContactInfoPtr;
+  public: typedef typename ParentClass::ContactBuffer ContactBuffer;
   public: typedef typename ParentClass::Shape Shape;
   public: typedef typename ParentClass::ModelLoadResult ModelLoadResult;
 
@@ -74,6 +91,75 @@ class GazeboPhysicsWorld:
   public: typedef typename ParentClass::PhysicsEnginePtr PhysicsEnginePtr;
   public: typedef typename ParentClass::WorldPtr WorldPtr;
 
+  /// \brief Handle which gives O(1) access to a model of this world.
+  ///
+  /// Obtain it once per model name with GetModelHandle() and use it instead
+  /// of the model name to avoid searching the model by its name each time.
+  /// A handle becomes invalid when the model is removed with RemoveModel().
+  /// A model which is removed in another way (e.g. via the Gazebo
+  /// transport) is detected once the Model object has been destroyed,
+  /// because the handle table does not keep the model alive.
+  /// All handles become invalid when Clear() or SetWorld() (and thereby
+  /// the Load* methods) are called, and when SetWorldState() inserts or
+  /// deletes models, because they may remove or replace models.
+  /// Operations on invalid handles fail.
+  public: struct ModelHandle
+  {
+    ModelHandle(): slot(-1), generation(0) {}
+    /// \return true if this handle was never assigned to a model.
+    /// Whether an assigned handle is still valid can be checked with
+    /// GazeboPhysicsWorld::IsValid().
+    bool IsNull() const { return slot < 0; }
+    // index in the handle table of the world
+    int slot;
+    // generation of the slot in the table when the handle was created
+    unsigned int generation;
+  };
+
+  /// \brief Compact snapshot of the dynamic state of all models, which
+  /// can be restored much faster than a WorldState.
+  ///
+  /// The poses and velocities of all links and the positions and
+  /// velocities of all joint axes are stored in flat arrays, in the order
+  /// of the models in \e modelNames. The links and joints of nested models
+  /// follow the ones of their parent model.
+  ///
+  /// A snapshot can only be restored with RestoreSnapshot() if the world
+  /// still has the same models (with the same links and joints), because it
+  /// does not contain the SDF of the models. This way, restoring it only
+  /// has to set the poses and velocities. The snapshot can be restored in
+  /// other worlds which have the same models, e.g. to reset several worlds
+  /// to a common start state.
+  ///
+  /// Get a snapshot repeatedly into the same instance with GetSnapshot()
+  /// to re-use the memory of the arrays.
+  public: struct Snapshot
+  {
+    Snapshot(): simTime(0) {}
+    // name of the world the snapshot was taken of
+    std::string worldName;
+    // simulation time in seconds
+    double simTime;
+    // name of each model
+    std::vector<std::string> modelNames;
+    // handle of each model in the world the snapshot was taken of
+    std::vector<ModelHandle> modelHandles;
+    // index of the first link of each model. Has one more element than
+    // there are models, the last one is the number of links.
+    std::vector<unsigned int> linkOffsets;
+    // index of the first joint axis of each model. Has one more element
+    // than there are models, the last one is the number of joint axes.
+    std::vector<unsigned int> jointOffsets;
+    // 7 values per link: world position (x, y, z) and
+    // rotation (w, x, y, z)
+    std::vector<double> linkPoses;
+    // 6 values per link: world linear and angular velocity
+    std::vector<double> linkVelocities;
+    // position and velocity of each joint axis
+    std::vector<double> jointPositions;
+    std::vector<double> jointVelocities;
+  };
+
   // set to true (default) to wait for the namespace for be loaded in
   // the Load* methods. Max wait time can be set in \e OnLoadMaxWaitForNamespace
   // and \e OnLoadMaxWaitForNamespaceSleep
@@ -83,7 +169,7 @@ class GazeboPhysicsWorld:
   public: static constexpr float OnLoadMaxWaitForNamespace = 10;
   // if \e OnLoadWaitForNamespace, sleep time in-between checks to wait for
   // whether the namespace has been loaded
-  public: static constexpr float OnLoadWaitForNamespaceSleep = 1;
+  public: static constexpr float OnLoadWaitForNamespaceSleep = 0.01;
 
   // \param enforceContactComputation by default, contacts in Gazebo are only
   //  computed if there is at least one subscriber to the contacts topic.
@@ -130,11 +216,15 @@ class GazeboPhysicsWorld:
 
   public: virtual std::vector<ModelID> GetAllModelIDs() const;
   public: virtual int GetIntegerModelID(const ModelID& id) const;
+  public: int GetIntegerModelID(const ModelHandle& handle) const;
 
   public: virtual bool RemoveModel(const ModelID& id);
+  public: bool RemoveModel(const ModelHandle& handle);
 
   public: virtual bool GetAABB(const ModelID& id,
                                Vector3& min, Vector3& max) const;
+  public: bool GetAABB(const ModelHandle& handle,
+                       Vector3& min, Vector3& max) const;
 
   public: virtual void Clear();
 
@@ -144,6 +234,29 @@ class GazeboPhysicsWorld:
 
   public: virtual OpResult SetWorldState(const WorldState& state, bool isDiff);
 
+  /// Writes the state of all models to \e snapshot, see Snapshot.
+  public: void GetSnapshot(Snapshot& snapshot) const;
+
+  /// Sets all models to the state in \e snapshot. This only succeeds
+  /// if the world has exactly the models of the snapshot, with the same
+  /// links and joints. Model handles stay valid.
+  /// \return false if the models of the world are not the same as in the
+  ///   snapshot, in which case the world is not changed. Use
+  ///   SetWorldState() with a WorldState instead in this case.
+  public: bool RestoreSnapshot(const Snapshot& snapshot);
+
+  /// \brief Creates a copy of this world named \e forkName, e.g. to branch
+  /// off several simulations from the current state.
+  ///
+  /// The copy is loaded from the SDF of this world and its models which
+  /// was already parsed, with the current physics settings, so no files
+  /// are read and the meshes are taken from the mesh cache of Gazebo.
+  /// The state of all models and the simulation time are then copied
+  /// with a Snapshot. The copy is paused if this world is paused.
+  /// \return the new world, or NULL if it could not be created
+  public: std::shared_ptr<GazeboPhysicsWorld>
+          Fork(const std::string& forkName) const;
+
   public: virtual void Update(int steps=1, bool force=false);
 
   public: virtual void SetPaused(bool flag);
@@ -161,6 +274,15 @@ class GazeboPhysicsWorld:
   public: virtual std::vector<ContactInfoPtr>
                   GetContactInfo(const ModelID& m1, const ModelID& m2) const;
 
+  public: virtual void FillContactBuffer(ContactBuffer& buffer) const;
+
+  public: virtual void FillContactBuffer(const ModelID& m1,
+                                         const ModelID& m2,
+                                         ContactBuffer& buffer) const;
+
+  public: virtual bool HasContacts(const ModelID& m1,
+                                   const ModelID& m2) const;
+
   /// Current warning for Gazebo implementation: Returned shared pointers
   /// are flakey, they will be deleted as soon as
   /// Gazebo ContactManager deletes them. This will be resolved as soon as
@@ -175,6 +297,17 @@ class GazeboPhysicsWorld:
   public: virtual std::vector<NativeContactPtr>
                   GetNativeContacts(const ModelID& m1, const ModelID& m2) const;
 
+  /// Returns the name of a model or link which has been interned by
+  /// this world, as referred to by ContactInfo::model1Id etc.
+  /// Throws an exception if \e id is not a valid ID.
+  /// The interned names are discarded when the world is cleared, replaced
+  /// or set to a state with other models, which invalidates the IDs.
+  public: std::string GetInternedName(const int id) const;
+
+  /// \return the interned ID of the model or link name \e name,
+  ///   or -1 if the name has not been interned by this world.
+  public: int GetInternedId(const std::string& name) const;
+
   public: virtual bool IsAdaptor() const;
 
   public: virtual RefResult SetWorld(const WorldPtr& world);
@@ -182,6 +315,15 @@ class GazeboPhysicsWorld:
   public: virtual WorldPtr GetWorld() const;
 
   public: virtual ModelPtr GetModel(const ModelID& model) const;
+  public: ModelPtr GetModel(const ModelHandle& handle) const;
+
+  /// Returns the handle for the model \e id. The first call for a
+  /// model resolves it, subsequent calls only do a hash lookup.
+  /// \return the handle, or a null handle if there is no such model.
+  public: ModelHandle GetModelHandle(const ModelID& id) const;
+
+  /// \return true if \e handle refers to a model which is still in the world
+  public: bool IsValid(const ModelHandle& handle) const;
 
   public: virtual PhysicsEnginePtr GetPhysicsEngine() const;
 
@@ -193,8 +335,22 @@ class GazeboPhysicsWorld:
   public: virtual bool SetBasicModelState(const ModelID& id,
                                           const BasicState& state);
 
+  public: bool SetBasicModelState(const ModelHandle& handle,
+                                  const BasicState& state);
+
+  public: virtual int SetBasicModelStates
+          (const std::vector<std::pair<ModelID, BasicState>>& states);
+
+  // Sets the states of all models in \e states, with all handles
+  // resolved at once.
+  // \return number of models for which the state was set.
+  public: int SetBasicModelStates
+          (const std::vector<std::pair<ModelHandle, BasicState>>& states);
+
   public: virtual bool GetBasicModelState(const ModelID& id,
                                           BasicState& state);
+  public: bool GetBasicModelState(const ModelHandle& handle,
+                                  BasicState& state) const;
 
 
   // Returns the absolute path which is used to temporarily write mesh files to.
@@ -215,6 +371,77 @@ class GazeboPhysicsWorld:
   // \brief called after a world has been loaded
   private: void PostWorldLoaded();
 
+  // returns the model referred to by \e handle, or NULL
+  // if the handle is invalid. modelSlotsMutex must be locked.
+  private: gazebo::physics::ModelPtr
+           ResolveModelHandleNoLock(const ModelHandle& handle) const;
+
+  // returns the model referred to by \e handle, or NULL
+  // if the handle is invalid.
+  private: gazebo::physics::ModelPtr
+           ResolveModelHandle(const ModelHandle& handle) const;
+
+  // Invalidates all model handles.
+  private: void InvalidateModelHandles();
+
+  // frees the slot \e idx, which invalidates all handles to it.
+  // modelSlotsMutex must be locked.
+  private: void FreeModelSlotNoLock(const int idx) const;
+
+  // helper function which can be used to get contact points of either
+  // all models (m1 and m2 set to NULL), or for one model
+  // (m1!=NULL and m2=NULL) or for two models (m1!=NULL and m2!=NULL).
+  private: void FillContactBufferHelper(ContactBuffer& buffer,
+                                        const ModelID * m1 = NULL,
+                                        const ModelID * m2 = NULL) const;
+
+  // same as FillContactBufferHelper() but returns ContactInfo instances
+  private: std::vector<ContactInfoPtr>
+           GetContactInfoHelper(const ModelID * m1 = NULL,
+                                const ModelID * m2 = NULL) const;
+
+  // same as FillContactBufferHelper() for native contacts
+  private: std::vector<NativeContactPtr>
+           GetNativeContactsHelper(const ModelID * m1 = NULL,
+                                   const ModelID * m2 = NULL) const;
+
+  // adds the contact points of \e c to \e buffer as a new pair.
+  // namesMutex must be locked.
+  private: void AddContactNoLock(const gazebo::physics::Contact& c,
+                                 ContactBuffer& buffer) const;
+
+  // builds the contact pair index if it is not valid. This also interns
+  // the names of all models which are in contact, so the names of
+  // queried models only have to be looked up with StringInterner::Find().
+  // namesMutex must be locked.
+  private: void UpdateContactPairIndexNoLock() const;
+
+  // returns the indices (in the contact manager) of all contacts between
+  // the models with interned IDs \e m1Id and \e m2Id, or NULL if there
+  // are none. Builds the contact pair index first if it is not valid.
+  // namesMutex must be locked.
+  private: const std::vector<unsigned int> *
+           GetPairContactsNoLock(const int m1Id, const int m2Id) const;
+
+  // invalidates the contact pair index. Has to be called whenever
+  // the contacts in the contact manager may have changed.
+  private: void InvalidateContactPairIndex();
+
+  // replaces the name table by an empty one and clears all entries which
+  // refer to the interned IDs. Has to be called when all models may have
+  // been replaced, so that the tables don't grow with each new set of
+  // models. Contact buffers filled before keep the old table.
+  private: void ResetContactNames();
+
+  // removes the entries of \e model and its links from entityNameIds.
+  // The interned names are kept.
+  private: void ForgetEntityNames(const gazebo::physics::Model& model);
+
+  // returns the interned ID of the name of \e entity (a model or link).
+  // The name is only read and interned the first time the entity is seen.
+  // namesMutex must be locked.
+  private: int GetEntityNameIdNoLock(const gazebo::physics::Base& entity) const;
+
   // Helper function which copies files which are specified as URIs in
   // the ``<uri>`` elemens within elements \e parentElementNames.
   // It copies the files to ``destinationBase/destinationSubdir`` and
@@ -252,6 +479,72 @@ class GazeboPhysicsWorld:
   // separately.
   private: bool paused;
 
+  // entry of the model handle table
+  private: struct ModelSlot
+  {
+    ModelSlot(): generation(0) {}
+    // the model, expired if the slot is free. The slot must not keep
+    // the model alive after it has been removed from the world.
+    boost::weak_ptr<gazebo::physics::Model> model;
+    // name of the model
+    std::string name;
+    // incremented each time the slot is freed,
+    // which invalidates all handles to it
+    unsigned int generation;
+  };
+
+  // The model handle table. Slots are assigned lazily by
+  // GetModelHandle(), so these are mutable.
+  private: mutable std::vector<ModelSlot> modelSlots;
+  // indices of the free slots in \e modelSlots
+  private: mutable std::vector<int> freeModelSlots;
+  // index in \e modelSlots of each model name
+  private: mutable std::unordered_map<std::string, int> modelSlotByName;
+  // mutex protecting the model handle table
+  private: mutable std::mutex modelSlotsMutex;
+
+  // Interned names of all models and links which were part of a contact.
+  // It is shared with the ContactBuffer instances filled by this world,
+  // which look up the names by the interned IDs only when they are needed.
+  private: class NameTable:
+    public ContactNameResolver<ModelID, ModelPartID>
+  {
+    public: virtual ModelID GetModelName(const int id) const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return names.GetString(id);
+    }
+    public: virtual ModelPartID GetModelPartName(const int id) const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return names.GetString(id);
+    }
+    public: StringInterner names;
+    // Protects names against the lookups of the contact buffers.
+    // GazeboPhysicsWorld only needs to lock it to intern a name.
+    public: mutable std::mutex mutex;
+  };
+
+  // Names are interned lazily during contact extraction,
+  // so the table is modified in const methods.
+  private: std::shared_ptr<NameTable> nameTable;
+  // interned name ID of each model and link by their Gazebo entity ID
+  private: mutable std::unordered_map<uint32_t, int> entityNameIds;
+  // Index of the contacts in the contact manager, by the pair of
+  // interned model name IDs (see GetPairContactsNoLock()). It is built
+  // lazily on the first query for a pair after the contacts have changed.
+  // Entries are only cleared, not removed, when the index is rebuilt, so
+  // that the memory can be re-used.
+  private: mutable std::unordered_map<uint64_t, std::vector<unsigned int>>
+           contactPairIndex;
+  // whether contactPairIndex is up to date with the contact manager
+  private: mutable bool contactPairIndexValid;
+  // mutex protecting nameTable, entityNameIds and the contact pair index
+  private: mutable std::mutex namesMutex;
+
+  // re-used by GetContactInfo(), along with the mutex protecting it
+  private: mutable ContactBuffer contactInfoBuffer;
+  private: mutable std::mutex contactInfoMutex;
 };  // class GazeboPhysicsWorld
 
 /// \def GazeboPhysicsWorldPtr
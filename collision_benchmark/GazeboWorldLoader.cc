@@ -25,7 +25,13 @@
 #include <gazebo/gazebo.hh>
 #include <gazebo/physics/physics.hh>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 using collision_benchmark::PhysicsWorldBaseInterface;
 using collision_benchmark::GazeboWorldLoader;
@@ -161,6 +167,72 @@ const std::string collision_benchmark::GetFirstNamespace()
   return namespaces.front();
 }
 
+// Watches the namespaces known to the Gazebo transport system on behalf of
+// all threads waiting for a namespace. Gazebo does not notify about new
+// namespaces outside of its ConnectionManager, so the list of the
+// TopicManager is polled. Only one waiting thread polls at a time, and it
+// wakes up all others each time it has read the list.
+class NamespaceWatcher
+{
+  public: NamespaceWatcher(): polling(false) {}
+
+  // waits until \e worldNamespace is known or \e maxWaitTime seconds
+  // have passed, reading the namespaces every \e pollTime seconds.
+  public: bool Wait(gazebo::transport::TopicManager * topicManager,
+                    const std::string& worldNamespace,
+                    const float maxWaitTime, const float pollTime)
+  {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point deadline = Clock::now() +
+      std::chrono::duration_cast<Clock::duration>
+        (std::chrono::duration<float>(maxWaitTime));
+    const std::chrono::duration<float> pollInterval(pollTime);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    bool found = namespaces.count(worldNamespace) > 0;
+    while (!found && Clock::now() < deadline)
+    {
+      if (polling)
+      {
+        changed.wait_until(lock, deadline);
+      }
+      else
+      {
+        polling = true;
+        lock.unlock();
+        std::list<std::string> current;
+        topicManager->GetTopicNamespaces(current);
+        lock.lock();
+        namespaces.clear();
+        namespaces.insert(current.begin(), current.end());
+        changed.notify_all();
+
+        if (namespaces.count(worldNamespace) == 0)
+        {
+          lock.unlock();
+          std::this_thread::sleep_until(std::min(deadline, Clock::now() +
+            std::chrono::duration_cast<Clock::duration>(pollInterval)));
+          lock.lock();
+        }
+        polling = false;
+      }
+      found = namespaces.count(worldNamespace) > 0;
+    }
+    // on every exit, also on timeout, another waiting
+    // thread has to take over polling
+    changed.notify_all();
+    return found;
+  }
+
+  private: std::mutex mutex;
+  // signalled when the namespaces have been read or polling stopped
+  private: std::condition_variable changed;
+  // namespaces at the last poll
+  private: std::set<std::string> namespaces;
+  // true while a thread is polling
+  private: bool polling;
+};
+
 bool collision_benchmark::WaitForNamespace(std::string worldNamespace,
                                            float maxWaitTime,
                                            float sleepTime)
@@ -173,48 +245,16 @@ bool collision_benchmark::WaitForNamespace(std::string worldNamespace,
     return false;
   }
 
-  gazebo::common::Timer timer;
-  timer.Start();
-
   std::cout << "Waiting for namespace '" << worldNamespace
             << " 'to be loaded." << std::endl;
 
-  bool found = false;
-  while (!found && (timer.GetElapsed().Float() < maxWaitTime))
-  {
-    // found at most 1 second for namespaces to appear.
-    if (gazebo::transport::waitForNamespaces(gazebo::common::Time(sleepTime,
-                                                                  0)))
-    {
-      std::list<std::string> namespaces;
-      topicManager->GetTopicNamespaces(namespaces);
-
-      /*std::cout<<"Namespaces:"<<std::endl;
-      for (std::list<std::string>::iterator it=namespaces.begin();
-           it!=namespaces.end(); ++it)
-        std::cout<<*it<<std::endl;*/
-
-      std::list<std::string>::iterator ns =
-        std::find(namespaces.begin(), namespaces.end(), worldNamespace);
-      bool loaded = (ns != namespaces.end()) && (*ns == worldNamespace);
-      if (loaded)
-      {
-        std::cout << "Namespace '" << worldNamespace
-                  << "' received." << std::endl;
-        found = true;
-      }
-      /*else
-      {
-        std::cout << "Namespace '" << worldNamespace
-                  << "' not received yet." << std::endl;
-      }*/
-    }
-    /*else
-    {
-      std::cout << "No namespaces received yet.\n";
-    }*/
-  }
-  if (!found)
+  static NamespaceWatcher watcher;
+  bool found = watcher.Wait(topicManager, worldNamespace,
+                            maxWaitTime, sleepTime);
+  if (found)
+    std::cout << "Namespace '" << worldNamespace
+              << "' received." << std::endl;
+  else
     std::cerr << "Unsuccessful wait for namespace "
               << worldNamespace<<"."<<std::endl;
 
@@ -363,6 +403,13 @@ collision_benchmark::GetPhysicsFromSDF(const std::string& filename)
   return sdfRoot;
 }
 
+// Serializes the loading of worlds in LoadWorldFromSDF():
+// gazebo::physics::create_world(), load_world() and init_world()
+// modify the global list of worlds without locking it, so worlds must
+// not be loaded concurrently, e.g. by the background thread of a WorldPool
+// and the main thread.
+static std::mutex worldLoadMutex;
+
 gazebo::physics::WorldPtr
 collision_benchmark::LoadWorldFromSDF(const sdf::ElementPtr& sdfRoot,
                                       const std::string& name,
@@ -392,7 +439,7 @@ collision_benchmark::LoadWorldFromSDF(const sdf::ElementPtr& sdfRoot,
     useName = sdfWorldName->GetAsString();
   }
 
-
+  std::lock_guard<std::mutex> lock(worldLoadMutex);
   if (gazebo::physics::has_world(useName))
   {
     std::cerr<<"World with name "<<useName<<" already exists."<<std::endl;
@@ -83,7 +83,11 @@ sdf::ElementPtr GetSDFElementFromString(const std::string& xmlString,
                                         const std::string& elemName,
                                         const std::string& name="");
 
-/// loads a world given a SDF element
+/// loads a world given a SDF element.
+/// Concurrent calls are serialized, because Gazebo adds the world to its
+/// global list of worlds, which is not thread safe. Other modifications of
+/// this list, e.g. gazebo::physics::remove_worlds(), must not be done while
+/// worlds are loaded.
 /// \param name if not empty string, then this name is used to override the
 ///       name in \e sdfRoot, which will
 ///       change \e sdfRoot itself
@@ -186,12 +190,13 @@ LoadWorlds(const std::vector<Worldfile>& worldfiles);
 
 /// Waits for the namespace \e worldNamespace to appear in the Gazebo
 /// list of namespaces.
-/// Repeatedly waits for new incoming namespaces (waiting *maximum*
-/// \e sleepTime seconds at each attempt)
-/// and checks whether the given \e worldNamespace is in the list of namespaces.
+/// The list of namespaces is read every \e sleepTime seconds and checked
+/// for \e worldNamespace. If several threads wait at the same time, only
+/// one of them reads the list and wakes up the others, so that all of them
+/// return as soon as their namespace has appeared.
 /// \param maxWaitTime waits for this maximum time (seconds)
 bool WaitForNamespace(std::string worldNamespace, float maxWaitTime = 10,
-                      float sleepTime = 1);
+                      float sleepTime = 0.01);
 
 
 /// return the first namespace loaded on the gazebo server,
@@ -56,6 +56,94 @@ void GetNewEntities(const gazebo::physics::WorldState& _state1,
   }
 }
 
+// hash of the name of a model or light, mixed so that the sum of the
+// hashes of several names is unlikely to collide. \e seed separates
+// the models from the lights.
+uint64_t EntityNameHash(const std::string& name, const uint64_t seed)
+{
+  // FNV-1a, finished with the mixing step of splitmix64
+  uint64_t h = 14695981039346656037ULL ^ seed;
+  for (std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+  {
+    h ^= static_cast<unsigned char>(*it);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+// seeds of EntityNameHash() for models and lights
+const uint64_t modelNameSeed = 0x6d6f64656cULL;
+const uint64_t lightNameSeed = 0x6c69676874ULL;
+
+uint64_t collision_benchmark::GetEntitySetFingerprint
+                    (const gazebo::physics::WorldState& state)
+{
+  // the sum is independent of the order of the names
+  uint64_t fingerprint = 0;
+  const gazebo::physics::ModelState_M& modelStates = state.GetModelStates();
+  for (gazebo::physics::ModelState_M::const_iterator it =
+       modelStates.begin(); it != modelStates.end(); ++it)
+  {
+    fingerprint += EntityNameHash(it->second.GetName(), modelNameSeed);
+  }
+  const gazebo::physics::LightState_M& lightStates = state.LightStates();
+  for (gazebo::physics::LightState_M::const_iterator it =
+       lightStates.begin(); it != lightStates.end(); ++it)
+  {
+    fingerprint += EntityNameHash(it->second.GetName(), lightNameSeed);
+  }
+  return fingerprint;
+}
+
+uint64_t collision_benchmark::GetEntitySetFingerprint
+                    (const gazebo::physics::WorldPtr& world)
+{
+  uint64_t fingerprint = 0;
+  const gazebo::physics::Model_V models = world->Models();
+  for (gazebo::physics::Model_V::const_iterator it = models.begin();
+       it != models.end(); ++it)
+  {
+    fingerprint += EntityNameHash((*it)->GetName(), modelNameSeed);
+  }
+  const gazebo::physics::Light_V lights = world->Lights();
+  for (gazebo::physics::Light_V::const_iterator it = lights.begin();
+       it != lights.end(); ++it)
+  {
+    fingerprint += EntityNameHash((*it)->GetName(), lightNameSeed);
+  }
+  return fingerprint;
+}
+
+// returns true if \e world has exactly the models and lights of \e state,
+// compared by name
+static bool HasSameEntities(const gazebo::physics::WorldPtr& world,
+                            const gazebo::physics::WorldState& state)
+{
+  const gazebo::physics::Model_V models = world->Models();
+  const gazebo::physics::Light_V lights = world->Lights();
+  if ((models.size() != state.GetModelStates().size()) ||
+      (lights.size() != state.LightStates().size()))
+    return false;
+  // names are unique, so with the same number of entities,
+  // it is enough to check that all of the world are in the state
+  for (gazebo::physics::Model_V::const_iterator it = models.begin();
+       it != models.end(); ++it)
+  {
+    if (!state.HasModelState((*it)->GetName())) return false;
+  }
+  for (gazebo::physics::Light_V::const_iterator it = lights.begin();
+       it != lights.end(); ++it)
+  {
+    if (!state.HasLightState((*it)->GetName())) return false;
+  }
+  return true;
+}
+
 /*void collision_benchmark::AddDiffWorldState(gazebo::physics::WorldPtr& world,
                                   const gazebo::physics::WorldState& diffState)
 {
@@ -73,11 +161,28 @@ void GetNewEntities(const gazebo::physics::WorldState& _state1,
 // XXX TODO REMOVE: Flags for testing
 #define FORCE_TARGET_TIME_VALUES
 // #define DEBUGWORLDSTATE
-void collision_benchmark::SetWorldState(gazebo::physics::WorldPtr& world,
+bool collision_benchmark::SetWorldState(gazebo::physics::WorldPtr& world,
                                const gazebo::physics::WorldState& targetState)
 {
   bool pauseState = world->IsPaused();
   world->SetPaused(true);
+
+  // Fast path: if the world has the same models and lights as the target
+  // state, there are no insertions or deletions, so the target state can be
+  // set straight away (step 2 below). This is the common case when
+  // transferring poses between worlds. The fingerprint rules out most
+  // other states cheaply, but as it may collide, the names are compared
+  // exactly before the state is set.
+  if ((world->ModelCount() == targetState.GetModelStateCount()) &&
+      (GetEntitySetFingerprint(world) ==
+       GetEntitySetFingerprint(targetState)) &&
+      HasSameEntities(world, targetState))
+  {
+    world->SetState(targetState);
+    world->SetPaused(pauseState);
+    return false;
+  }
+
   gazebo::physics::WorldState currentState(world);
 
 #ifdef DEBUGWORLDSTATE
@@ -205,6 +310,7 @@ void collision_benchmark::SetWorldState(gazebo::physics::WorldPtr& world,
 #endif
 
   world->SetPaused(pauseState);
+  return true;
 }
 
 
@@ -20,16 +20,38 @@
 #include <collision_benchmark/PhysicsWorld.hh>
 #include <gazebo/physics/World.hh>
 
+#include <cstdint>
+
 namespace collision_benchmark
 {
 
 
 /**
- * Sets the \e world to the state \e targetState
+ * Sets the \e world to the state \e targetState.
+ * If the world already has the same models and lights as \e targetState
+ * (pre-filtered with GetEntitySetFingerprint() and then compared by
+ * name), the state is set directly. Otherwise,
+ * the models and lights are inserted and deleted first.
+ * \return true if models or lights were inserted or deleted
  */
-void SetWorldState(gazebo::physics::WorldPtr& world,
+bool SetWorldState(gazebo::physics::WorldPtr& world,
                    const gazebo::physics::WorldState& targetState);
 
+/**
+ * Returns a fingerprint of the names of all models and lights in the
+ * state. The fingerprint does not depend on the order of the models and
+ * lights, so two states with the same models and lights have the same
+ * fingerprint.
+ */
+uint64_t GetEntitySetFingerprint(const gazebo::physics::WorldState& state);
+
+/**
+ * Returns the fingerprint of the names of all models and lights in the
+ * \e world. This is the same as the fingerprint of the state of the world,
+ * but does not require to build the state.
+ */
+uint64_t GetEntitySetFingerprint(const gazebo::physics::WorldPtr& world);
+
 /**
  * Print the world state. Can be used for testing.
  */
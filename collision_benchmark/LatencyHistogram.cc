@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Lock-free histogram of latencies with logarithmic buckets
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/LatencyHistogram.hh>
+
+#include <limits>
+
+using collision_benchmark::LatencyHistogram;
+
+const unsigned int LatencyHistogram::subBucketBits;
+const unsigned int LatencyHistogram::numSubBuckets;
+const unsigned int LatencyHistogram::numBuckets;
+
+/////////////////////////////////////////////
+double LatencyHistogram::Snapshot::GetMean() const
+{
+  return count > 0 ? sum / static_cast<double>(count) : 0;
+}
+
+/////////////////////////////////////////////
+uint64_t LatencyHistogram::Snapshot::GetPercentile(const double p) const
+{
+  if (count == 0) return 0;
+  double rank = p / 100.0 * count;
+  if (rank < 1) rank = 1;
+  uint64_t cumulative = 0;
+  for (unsigned int i = 0; i < counts.size(); ++i)
+  {
+    cumulative += counts[i];
+    if (cumulative >= rank)
+    {
+      uint64_t upper = GetBucketUpperBound(i);
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+/////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram()
+{
+  Reset();
+}
+
+/////////////////////////////////////////////
+void LatencyHistogram::Record(const uint64_t ns, const uint64_t num)
+{
+  if (num == 0) return;
+  counts[GetBucketIndex(ns)].fetch_add(num, std::memory_order_relaxed);
+  count.fetch_add(num, std::memory_order_relaxed);
+  sum.fetch_add(ns * num, std::memory_order_relaxed);
+
+  uint64_t current = min.load(std::memory_order_relaxed);
+  while (ns < current &&
+         !min.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+  {
+  }
+  current = max.load(std::memory_order_relaxed);
+  while (ns > current &&
+         !max.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+  {
+  }
+}
+
+/////////////////////////////////////////////
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+  Snapshot s;
+  s.counts.resize(numBuckets);
+  for (unsigned int i = 0; i < numBuckets; ++i)
+  {
+    s.counts[i] = counts[i].load(std::memory_order_relaxed);
+  }
+  s.count = count.load(std::memory_order_relaxed);
+  s.sum = sum.load(std::memory_order_relaxed);
+  if (s.count > 0)
+  {
+    s.min = min.load(std::memory_order_relaxed);
+    s.max = max.load(std::memory_order_relaxed);
+  }
+  return s;
+}
+
+/////////////////////////////////////////////
+void LatencyHistogram::Reset()
+{
+  for (unsigned int i = 0; i < numBuckets; ++i)
+  {
+    counts[i].store(0, std::memory_order_relaxed);
+  }
+  count.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+}
+
+/////////////////////////////////////////////
+unsigned int LatencyHistogram::GetBucketIndex(const uint64_t ns)
+{
+  if (ns < numSubBuckets) return ns;
+  // position of the highest set bit, at least subBucketBits
+  unsigned int msb = 63 - __builtin_clzll(ns);
+  unsigned int shift = msb - subBucketBits;
+  // the subBucketBits + 1 highest bits, in [numSubBuckets, 2*numSubBuckets)
+  unsigned int mantissa = ns >> shift;
+  return (shift + 1) * numSubBuckets + (mantissa - numSubBuckets);
+}
+
+/////////////////////////////////////////////
+uint64_t LatencyHistogram::GetBucketUpperBound(const unsigned int idx)
+{
+  if (idx < numSubBuckets) return idx;
+  unsigned int shift = idx / numSubBuckets - 1;
+  uint64_t mantissa = idx % numSubBuckets + numSubBuckets;
+  // the upper bound of the last bucket overflows to 0
+  uint64_t next = (mantissa + 1) << shift;
+  if (next == 0) return std::numeric_limits<uint64_t>::max();
+  return next - 1;
+}
+
+/////////////////////////////////////////////
+std::ostream& collision_benchmark::operator<<
+  (std::ostream& o, const LatencyHistogram::Snapshot& s)
+{
+  o << s.count << " samples, mean " << s.GetMean() / 1e3 << "us, "
+    << "p50 " << s.GetPercentile(50) / 1e3 << "us, "
+    << "p99 " << s.GetPercentile(99) / 1e3 << "us, "
+    << "max " << s.max / 1e3 << "us";
+  return o;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Lock-free histogram of latencies with logarithmic buckets
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_LATENCYHISTOGRAM_H
+#define COLLISION_BENCHMARK_LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace collision_benchmark
+{
+
+/**
+ * \brief Histogram of latencies (in nanoseconds) which can be recorded
+ * concurrently from several threads without locking.
+ *
+ * The buckets are log-linear like in a HDR histogram: each power of two
+ * is split into the same number of linear sub-buckets, so that the
+ * relative error of a value read from the histogram is the same (about 6%)
+ * over the whole range of 64 bit values, while the number of buckets is
+ * fixed. Recording a value only does a few atomic increments.
+ *
+ * The recorded values can be read with GetSnapshot() while values
+ * are still being recorded. The snapshot is not necessarily consistent
+ * with values recorded at the same time, which is fine for statistics.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class LatencyHistogram
+{
+  public: typedef std::shared_ptr<LatencyHistogram> Ptr;
+  public: typedef std::shared_ptr<const LatencyHistogram> ConstPtr;
+
+  /// Copy of the values of the histogram at one point in time
+  public: struct Snapshot
+  {
+    Snapshot(): count(0), sum(0), min(0), max(0) {}
+
+    /// \return the mean of the values, or 0 if there are none
+    double GetMean() const;
+
+    /// \return the value at percentile \e p (0..100). The value is the
+    ///   upper bound of the bucket containing the percentile, but never
+    ///   larger than the maximum value. Returns 0 if there are no values.
+    uint64_t GetPercentile(const double p) const;
+
+    // number of values in each bucket
+    std::vector<uint64_t> counts;
+    // number of values
+    uint64_t count;
+    // sum of all values
+    uint64_t sum;
+    // smallest and largest value, 0 if there are no values
+    uint64_t min;
+    uint64_t max;
+  };
+
+  public: LatencyHistogram();
+
+  /// Records \e num times the value \e ns
+  public: void Record(const uint64_t ns, const uint64_t num = 1);
+
+  /// \return copy of the current values
+  public: Snapshot GetSnapshot() const;
+
+  /// Removes all values
+  public: void Reset();
+
+  /// \return the index of the bucket of value \e ns
+  public: static unsigned int GetBucketIndex(const uint64_t ns);
+
+  /// \return the largest value which falls into bucket \e idx
+  public: static uint64_t GetBucketUpperBound(const unsigned int idx);
+
+  // number of linear sub-buckets per power of two is 2^subBucketBits
+  public: static const unsigned int subBucketBits = 4;
+  public: static const unsigned int numSubBuckets = 1u << subBucketBits;
+  // values below numSubBuckets have a bucket each, each larger power
+  // of two has numSubBuckets buckets.
+  public: static const unsigned int numBuckets =
+            (64 - subBucketBits + 1) * numSubBuckets;
+
+  private: LatencyHistogram(const LatencyHistogram&);
+  private: LatencyHistogram& operator=(const LatencyHistogram&);
+
+  private: std::atomic<uint64_t> counts[numBuckets];
+  private: std::atomic<uint64_t> count;
+  private: std::atomic<uint64_t> sum;
+  private: std::atomic<uint64_t> min;
+  private: std::atomic<uint64_t> max;
+};
+
+/// Prints count, mean, percentiles and maximum of the snapshot
+/// in microseconds
+std::ostream& operator<<(std::ostream& o,
+                         const LatencyHistogram::Snapshot& s);
+
+}  // namespace collision_benchmark
+#endif  // COLLISION_BENCHMARK_LATENCYHISTOGRAM_H
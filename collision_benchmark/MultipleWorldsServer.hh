@@ -148,19 +148,13 @@ class MultipleWorldsServer
                    const std::string& worldname = "")
   {
     assert(worldManager);
-    WorldLoader_M::iterator wlIt = worldLoaders.find(engine);
-    if (wlIt == worldLoaders.end())
+    if (worldLoaders.find(engine) == worldLoaders.end())
     {
       return -1;
     }
-    WorldLoader::ConstPtr loader = wlIt->second;
-    assert(loader);
-
-    std::cout << "Loading with physics engine " << engine
-              << " (named as '" << worldname << "')" << std::endl;
 
     PhysicsWorldBaseInterface::Ptr world =
-      loader->LoadFromFile(worldfile, worldname);
+      LoadWorld(worldfile, engine, worldname);
 
     if (!world) return -2;
 
@@ -169,6 +163,34 @@ class MultipleWorldsServer
     return ret;
   }
 
+  // \brief Loads the world file with the given engine, but unlike Load(),
+  // does not add the world to the WorldManager. This can be used to
+  // create worlds which are managed separately, e.g. by another WorldManager.
+  // \param worldfile the filename the filename
+  // \param engine the physics engine (identified by name) to use.
+  // \param worldname name to use for the world. If empty, will use the
+  //    name specified in the file.
+  // \return the world, or NULL if there is no world loader for this engine
+  //    or the world could not be loaded.
+  public: PhysicsWorldBaseInterface::Ptr
+          LoadWorld(const std::string& worldfile,
+                    const std::string& engine,
+                    const std::string& worldname = "") const
+  {
+    WorldLoader_M::const_iterator wlIt = worldLoaders.find(engine);
+    if (wlIt == worldLoaders.end())
+    {
+      return PhysicsWorldBaseInterface::Ptr();
+    }
+    WorldLoader::ConstPtr loader = wlIt->second;
+    assert(loader);
+
+    std::cout << "Loading with physics engine " << engine
+              << " (named as '" << worldname << "')" << std::endl;
+
+    return loader->LoadFromFile(worldfile, worldname);
+  }
+
   // \brief Loads the world file and determines the engine to use from the file.
   // This will create one new worlds using the engine determined
   // from the file. The world will be added to the WorldManager.
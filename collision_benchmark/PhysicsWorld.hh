@@ -18,11 +18,14 @@
  */
 
 #include <collision_benchmark/ContactInfo.hh>
+#include <collision_benchmark/ContactBuffer.hh>
 #include <collision_benchmark/Shape.hh>
 #include <collision_benchmark/BasicTypes.hh>
 #include <sdf/sdf.hh>
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace collision_benchmark
 {
@@ -328,6 +331,23 @@ class PhysicsWorldModelInterface
   public: virtual bool SetBasicModelState(const ModelID& id,
                                           const BasicState& state) = 0;
 
+  /// Sets the pose and scale of several models at once. Implementations
+  /// can override this to resolve all models in one go, which is faster
+  /// than calling SetBasicModelState() for each model.
+  /// The default implementation calls SetBasicModelState() for each model.
+  /// \return number of models for which the state was set.
+  public: virtual int SetBasicModelStates
+          (const std::vector<std::pair<ModelID, BasicState>>& states)
+  {
+    int cnt = 0;
+    for (typename std::vector<std::pair<ModelID, BasicState>>::const_iterator
+         it = states.begin(); it != states.end(); ++it)
+    {
+      if (SetBasicModelState(it->first, it->second)) ++cnt;
+    }
+    return cnt;
+  }
+
   /// Gets the pose and scale of a model.
   /// \retval false the model was not in the world
   public: virtual bool GetBasicModelState(const ModelID& id,
@@ -374,6 +394,9 @@ class PhysicsWorldContactInterface
                                                    ModelPartID> ContactInfo;
   public: typedef typename ContactInfo::Ptr ContactInfoPtr;
 
+  public: typedef collision_benchmark::ContactBuffer<Vector3, Wrench, ModelID,
+                                                     ModelPartID> ContactBuffer;
+
   public: PhysicsWorldContactInterface(){}
   public: virtual ~PhysicsWorldContactInterface(){}
 
@@ -393,6 +416,52 @@ class PhysicsWorldContactInterface
   public: virtual std::vector<ContactInfoPtr>
                   GetContactInfo(const ModelID& m1,
                                  const ModelID& m2) const = 0;
+
+  /// Works as GetContactInfo() but writes the contact points into
+  /// \e buffer, which is cleared first. When the same buffer is used
+  /// in each step, this avoids memory allocation once the buffer
+  /// has grown large enough.
+  ///
+  /// The default implementation copies the result of GetContactInfo(),
+  /// implementations should override this to fill the buffer directly.
+  public: virtual void FillContactBuffer(ContactBuffer& buffer) const
+  {
+    FillContactBufferHelper(GetContactInfo(), buffer);
+  }
+
+  /// Works as FillContactBuffer() but only adds the contact points between
+  /// models \e m1 and \e m2.
+  public: virtual void FillContactBuffer(const ModelID& m1,
+                                         const ModelID& m2,
+                                         ContactBuffer& buffer) const
+  {
+    FillContactBufferHelper(GetContactInfo(m1, m2), buffer);
+  }
+
+  /// \return true if there are contact points between models \e m1 and
+  /// \e m2, which is the case if FillContactBuffer(m1, m2, buffer) adds at
+  /// least one pair to the buffer.
+  ///
+  /// The default implementation calls GetContactInfo(m1, m2),
+  /// implementations should override this to avoid extracting
+  /// the contact points.
+  public: virtual bool HasContacts(const ModelID& m1,
+                                   const ModelID& m2) const
+  {
+    return !GetContactInfo(m1, m2).empty();
+  }
+
+  private: static void
+           FillContactBufferHelper(const std::vector<ContactInfoPtr>& contacts,
+                                   ContactBuffer& buffer)
+  {
+    buffer.Clear();
+    for (typename std::vector<ContactInfoPtr>::const_iterator
+         it = contacts.begin(); it != contacts.end(); ++it)
+    {
+      buffer.Add(**it);
+    }
+  }
 };
 
 /**
@@ -548,6 +617,9 @@ class PhysicsWorld:
 
   public: typedef typename PhysicsWorldContactParent::ContactInfo ContactInfo;
   public: typedef typename ContactInfo::Ptr ContactInfoPtr;
+
+  public: typedef typename PhysicsWorldContactParent::ContactBuffer
+            ContactBuffer;
 };
 
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Table mapping strings to small integer IDs
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/StringInterner.hh>
+#include <collision_benchmark/Exception.hh>
+
+using collision_benchmark::StringInterner;
+
+/////////////////////////////////////////////////
+int StringInterner::Intern(const std::string& str)
+{
+  std::unordered_map<std::string, int>::const_iterator it = ids.find(str);
+  if (it != ids.end()) return it->second;
+  int id = strings.size();
+  strings.push_back(str);
+  ids[str] = id;
+  return id;
+}
+
+/////////////////////////////////////////////////
+int StringInterner::Find(const std::string& str) const
+{
+  std::unordered_map<std::string, int>::const_iterator it = ids.find(str);
+  if (it == ids.end()) return -1;
+  return it->second;
+}
+
+/////////////////////////////////////////////////
+const std::string& StringInterner::GetString(const int id) const
+{
+  if (id < 0 || static_cast<size_t>(id) >= strings.size())
+  {
+    THROW_EXCEPTION("No string with ID " << id << " interned");
+  }
+  return strings[id];
+}
+
+/////////////////////////////////////////////////
+size_t StringInterner::Size() const
+{
+  return strings.size();
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Table mapping strings to small integer IDs
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_STRINGINTERNER_H
+#define COLLISION_BENCHMARK_STRINGINTERNER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace collision_benchmark
+{
+
+/**
+ * \brief Maps strings to small integer IDs, so that they can be
+ * stored and compared as integers and only need to be resolved to
+ * the string when needed.
+ *
+ * IDs are consecutive and start at 0, and the ID of a string never
+ * changes. This class is not thread safe.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class StringInterner
+{
+  public: StringInterner() {}
+
+  /// \return the ID of \e str. If \e str has not been interned
+  ///   before, it is added with a new ID.
+  public: int Intern(const std::string& str);
+
+  /// \return the ID of \e str, or -1 if \e str has not been interned.
+  public: int Find(const std::string& str) const;
+
+  /// \return the string with ID \e id. The reference is only valid
+  ///   until the next call of Intern(). Throws an exception if there
+  ///   is no string with this ID.
+  public: const std::string& GetString(const int id) const;
+
+  /// \return number of interned strings
+  public: size_t Size() const;
+
+  // ID of each string
+  private: std::unordered_map<std::string, int> ids;
+
+  // all strings, at the index of their ID
+  private: std::vector<std::string> strings;
+};
+
+}  // namespace collision_benchmark
+#endif  // COLLISION_BENCHMARK_STRINGINTERNER_H
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Recording of scoped trace events for the Chrome trace viewer
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/Trace.hh>
+#include <collision_benchmark/StringInterner.hh>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using collision_benchmark::Trace;
+
+std::atomic<bool> Trace::enabled(false);
+
+namespace
+{
+// one recorded event
+struct TraceEvent
+{
+  const char * name;
+  int64_t start;
+  int64_t end;
+  int track;
+};
+
+// ring buffer of the events of one thread. Only the thread
+// owning the buffer writes to it.
+struct ThreadBuffer
+{
+  ThreadBuffer(const unsigned int capacity, const int _threadIdx):
+    events(capacity), numEvents(0), threadIdx(_threadIdx) {}
+  std::vector<TraceEvent> events;
+  // number of events written so far. The next event is written at
+  // numEvents % events.size().
+  std::atomic<uint64_t> numEvents;
+  // index of the thread, used as the ID of its track
+  int threadIdx;
+};
+
+// the buffers of all threads and the track names. Buffers are registered
+// when a thread records its first event after the last call of Clear().
+struct TraceRegistry
+{
+  TraceRegistry(): capacity(1 << 16), generation(0) {}
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  collision_benchmark::StringInterner tracks;
+  unsigned int capacity;
+  // incremented in Clear(), so that the threads register a new buffer
+  std::atomic<uint64_t> generation;
+};
+
+TraceRegistry& GetRegistry()
+{
+  static TraceRegistry registry;
+  return registry;
+}
+
+// buffer of the current thread and the generation it was registered in.
+// The thread shares ownership of the buffer, so it stays valid if the
+// registry is cleared.
+thread_local std::shared_ptr<ThreadBuffer> threadBuffer;
+thread_local uint64_t threadBufferGeneration = 0;
+
+// IDs of the tracks which the current thread has looked up before, so
+// that GetTrackID() only locks the registry on the first lookup of a
+// track. Tracks are never removed, so the IDs stay valid.
+thread_local std::unordered_map<std::string, int> threadTrackIDs;
+
+ThreadBuffer& GetThreadBuffer()
+{
+  TraceRegistry& registry = GetRegistry();
+  uint64_t generation = registry.generation.load(std::memory_order_acquire);
+  if (!threadBuffer || threadBufferGeneration != generation)
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    threadBuffer.reset(new ThreadBuffer(registry.capacity,
+                                        registry.buffers.size() + 1));
+    registry.buffers.push_back(threadBuffer);
+    threadBufferGeneration = registry.generation;
+  }
+  return *threadBuffer;
+}
+
+// writes \e str as a JSON string
+void WriteJSONString(std::ostream& out, const std::string& str)
+{
+  out << '"';
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+  {
+    if (*it == '"' || *it == '\\') out << '\\' << *it;
+    else if (static_cast<unsigned char>(*it) < 0x20) out << ' ';
+    else out << *it;
+  }
+  out << '"';
+}
+
+// writes one complete event ("X") in microseconds
+void WriteEvent(std::ostream& out, const TraceEvent& e,
+                const int pid, const int tid)
+{
+  out << "{\"name\":";
+  WriteJSONString(out, e.name);
+  out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+      << ",\"ts\":" << e.start / 1e3 << ",\"dur\":"
+      << (e.end - e.start) / 1e3 << "}";
+}
+
+// writes the metadata event which names a track
+void WriteTrackName(std::ostream& out, const int pid, const int tid,
+                    const std::string& name)
+{
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+      << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+  WriteJSONString(out, name);
+  out << "}}";
+}
+
+// process IDs used to group the tracks of the threads and of the worlds
+const int threadsPid = 1;
+const int worldsPid = 2;
+}  // namespace
+
+/////////////////////////////////////////////
+void Trace::Enable(const unsigned int capacity)
+{
+  Clear();
+  {
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.capacity = capacity > 0 ? capacity : 1;
+  }
+  enabled = true;
+}
+
+/////////////////////////////////////////////
+void Trace::Disable()
+{
+  enabled = false;
+}
+
+/////////////////////////////////////////////
+void Trace::Clear()
+{
+  TraceRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.buffers.clear();
+  ++registry.generation;
+}
+
+/////////////////////////////////////////////
+int Trace::GetTrackID(const std::string& name)
+{
+  std::unordered_map<std::string, int>::const_iterator it =
+    threadTrackIDs.find(name);
+  if (it != threadTrackIDs.end()) return it->second;
+  TraceRegistry& registry = GetRegistry();
+  int id;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    id = registry.tracks.Intern(name) + 1;
+  }
+  threadTrackIDs[name] = id;
+  return id;
+}
+
+/////////////////////////////////////////////
+void Trace::Record(const char * name, const int64_t start,
+                   const int64_t end, const int track)
+{
+  ThreadBuffer& buffer = GetThreadBuffer();
+  uint64_t n = buffer.numEvents.load(std::memory_order_relaxed);
+  TraceEvent& e = buffer.events[n % buffer.events.size()];
+  e.name = name;
+  e.start = start;
+  e.end = end;
+  e.track = track;
+  buffer.numEvents.store(n + 1, std::memory_order_release);
+}
+
+/////////////////////////////////////////////
+int64_t Trace::Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////
+void Trace::WriteChromeJSON(std::ostream& out)
+{
+  TraceRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  // the times are written in microseconds with nanosecond precision
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << threadsPid
+      << ",\"args\":{\"name\":\"Threads\"}}," << std::endl;
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << worldsPid
+      << ",\"args\":{\"name\":\"Worlds\"}}";
+  for (unsigned int i = 0; i < registry.tracks.Size(); ++i)
+  {
+    out << "," << std::endl;
+    WriteTrackName(out, worldsPid, i + 1, registry.tracks.GetString(i));
+  }
+
+  for (unsigned int b = 0; b < registry.buffers.size(); ++b)
+  {
+    const ThreadBuffer& buffer = *registry.buffers[b];
+    std::stringstream threadName;
+    threadName << "Thread " << buffer.threadIdx;
+    out << "," << std::endl;
+    WriteTrackName(out, threadsPid, buffer.threadIdx, threadName.str());
+
+    uint64_t n = buffer.numEvents.load(std::memory_order_acquire);
+    uint64_t capacity = buffer.events.size();
+    // the oldest events have been overwritten if the buffer is full
+    for (uint64_t i = (n > capacity ? n - capacity : 0); i < n; ++i)
+    {
+      const TraceEvent& e = buffer.events[i % capacity];
+      out << "," << std::endl;
+      WriteEvent(out, e, threadsPid, buffer.threadIdx);
+      if (e.track > 0)
+      {
+        out << "," << std::endl;
+        WriteEvent(out, e, worldsPid, e.track);
+      }
+    }
+  }
+  out << std::endl << "]}" << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+/////////////////////////////////////////////
+bool Trace::WriteChromeJSON(const std::string& file)
+{
+  std::ofstream out(file.c_str());
+  if (!out)
+  {
+    std::cerr << "Could not write trace to " << file << std::endl;
+    return false;
+  }
+  WriteChromeJSON(out);
+  return out.good();
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Recording of scoped trace events for the Chrome trace viewer
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_TRACE_H
+#define COLLISION_BENCHMARK_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace collision_benchmark
+{
+
+/**
+ * \brief Records the time spent in scopes, to be viewed on a timeline in
+ * the Chrome trace viewer (chrome://tracing) or in Perfetto.
+ *
+ * Events are recorded with the macros TRACE_SCOPE and TRACE_WORLD_SCOPE.
+ * Each thread writes its events into its own ring buffer, so recording
+ * an event needs no locking. When the ring buffer of a thread is full,
+ * its oldest events are overwritten.
+ *
+ * While tracing is disabled, a scope only checks one flag. Defining
+ * COLLISION_BENCHMARK_NO_TRACE removes the macros altogether.
+ *
+ * WriteChromeJSON() writes the events in the Chrome Trace Event format,
+ * with one track per thread. Events which were recorded for a world
+ * (with TRACE_WORLD_SCOPE) are in addition shown on a track of the world.
+ * The events should only be written while no events are recorded.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class Trace
+{
+  /// Starts recording events. All events recorded before are removed.
+  /// \param capacity maximum number of events kept per thread
+  public: static void Enable(const unsigned int capacity = 1 << 16);
+
+  /// Stops recording events. The events recorded so far are kept.
+  public: static void Disable();
+
+  /// \return true if events are recorded
+  public: static bool IsEnabled()
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  /// Removes all events
+  public: static void Clear();
+
+  /// Writes all events in the Chrome Trace Event JSON format
+  public: static void WriteChromeJSON(std::ostream& out);
+
+  /// Writes all events in the Chrome Trace Event JSON format to \e file
+  /// \return false if the file could not be written
+  public: static bool WriteChromeJSON(const std::string& file);
+
+  /// \return the ID of the track \e name, to be used in Record().
+  ///   IDs start at 1. The IDs are cached per thread, so only the first
+  ///   call for a track in each thread locks the list of tracks.
+  public: static int GetTrackID(const std::string& name);
+
+  /// Records an event in the buffer of the calling thread
+  /// \param name name of the event. Must be a string literal or
+  ///    otherwise stay valid until the events are written.
+  /// \param start start of the event in nanoseconds, as returned by Now()
+  /// \param end end of the event in nanoseconds, as returned by Now()
+  /// \param track ID of the track as returned by GetTrackID(),
+  ///   or 0 if the event is only shown on the track of the thread.
+  public: static void Record(const char * name, const int64_t start,
+                             const int64_t end, const int track = 0);
+
+  /// \return current time in nanoseconds, of a steady clock
+  public: static int64_t Now();
+
+  private: static std::atomic<bool> enabled;
+};
+
+/**
+ * \brief Records the time from its construction to its destruction
+ * as a trace event, if tracing was enabled on construction.
+ * Use with the macros TRACE_SCOPE and TRACE_WORLD_SCOPE.
+ */
+class TraceScope
+{
+  /// \param _name name of the event, see Trace::Record()
+  public: explicit TraceScope(const char * _name):
+            name(_name),
+            start(Trace::IsEnabled() ? Trace::Now() : -1),
+            track(0) {}
+
+  public: ~TraceScope()
+  {
+    if (start >= 0) Trace::Record(name, start, Trace::Now(), track);
+  }
+
+  /// \return true if the event is recorded
+  public: bool IsActive() const
+  {
+    return start >= 0;
+  }
+
+  /// Shows the event on the track \e trackName in addition
+  /// to the track of the thread.
+  public: void SetTrack(const std::string& trackName)
+  {
+    track = Trace::GetTrackID(trackName);
+  }
+
+  private: TraceScope(const TraceScope&);
+  private: TraceScope& operator=(const TraceScope&);
+
+  private: const char * name;
+  private: int64_t start;
+  private: int track;
+};
+
+}  // namespace collision_benchmark
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifndef COLLISION_BENCHMARK_NO_TRACE
+/// Records the rest of the current scope as event \e name
+#define TRACE_SCOPE(name) \
+  collision_benchmark::TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+/// Records the rest of the current scope as event \e name and shows it on
+/// the track of the world \e worldName as well. \e worldName is only
+/// evaluated if tracing is enabled.
+#define TRACE_WORLD_SCOPE(name, worldName) \
+  collision_benchmark::TraceScope TRACE_CONCAT(traceScope, __LINE__)(name); \
+  if (TRACE_CONCAT(traceScope, __LINE__).IsActive()) \
+    TRACE_CONCAT(traceScope, __LINE__).SetTrack(worldName)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_WORLD_SCOPE(name, worldName)
+#endif
+
+#endif  // COLLISION_BENCHMARK_TRACE_H
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Persistent pool of worker threads with work stealing
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/WorkerPool.hh>
+
+#include <chrono>
+
+using collision_benchmark::WorkerPool;
+
+namespace
+{
+// the pool and index of the worker which runs in the current thread,
+// used by Spawn() to find the local queue.
+thread_local const WorkerPool * currentPool = NULL;
+thread_local unsigned int currentWorker = 0;
+
+int64_t NowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+WorkerPool::WorkerPool(const unsigned int numWorkers):
+  pending(0),
+  queued(0),
+  stop(false),
+  statisticsStart(NowNs())
+{
+  unsigned int num = numWorkers;
+  if (num == 0) num = std::thread::hardware_concurrency();
+  // hardware_concurrency() may return 0 if it can't be determined
+  if (num == 0) num = 1;
+  for (unsigned int i = 0; i < num; ++i)
+  {
+    workers.push_back(std::unique_ptr<Worker>(new Worker()));
+  }
+  // start the threads only after all queues exist, because
+  // workers access the queues of others for stealing.
+  for (unsigned int i = 0; i < num; ++i)
+  {
+    workers[i]->thread = std::thread(&WorkerPool::WorkerLoop, this, i);
+  }
+}
+
+/////////////////////////////////////////////////
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  workAvailable.notify_all();
+  for (unsigned int i = 0; i < workers.size(); ++i)
+  {
+    if (workers[i]->thread.joinable()) workers[i]->thread.join();
+  }
+}
+
+/////////////////////////////////////////////////
+unsigned int WorkerPool::GetNumWorkers() const
+{
+  return workers.size();
+}
+
+/////////////////////////////////////////////////
+void WorkerPool::RunAll(const std::vector<Task>& tasks)
+{
+  if (tasks.empty()) return;
+  std::lock_guard<std::mutex> runLock(runMutex);
+  pending += tasks.size();
+  // initially distribute the tasks evenly, the
+  // workers balance the load by stealing.
+  for (unsigned int i = 0; i < tasks.size(); ++i)
+  {
+    Push(i % workers.size(), tasks[i]);
+  }
+
+  std::exception_ptr batchError;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    // barrier: wait until all tasks of this batch have finished
+    batchDone.wait(lock, [this]{ return pending == 0; });
+    batchError = error;
+    error = std::exception_ptr();
+  }
+  if (batchError) std::rethrow_exception(batchError);
+}
+
+/////////////////////////////////////////////////
+void WorkerPool::Spawn(const Task& task)
+{
+  ++pending;
+  if (currentPool == this) Push(currentWorker, task);
+  else Push(0, task);
+}
+
+/////////////////////////////////////////////////
+void WorkerPool::Push(const unsigned int idx, const Task& task)
+{
+  {
+    // count the task before it becomes visible in the queue, so that
+    // queued never drops below 0 when it is taken right away.
+    std::lock_guard<std::mutex> lock(mutex);
+    ++queued;
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers[idx]->mutex);
+    workers[idx]->tasks.push_back(task);
+  }
+  workAvailable.notify_one();
+}
+
+/////////////////////////////////////////////////
+bool WorkerPool::Pop(const unsigned int idx, Task& task, bool& stolen)
+{
+  {
+    Worker& w = *workers[idx];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (!w.tasks.empty())
+    {
+      task = w.tasks.back();
+      w.tasks.pop_back();
+      --queued;
+      stolen = false;
+      return true;
+    }
+  }
+  for (unsigned int i = 1; i < workers.size(); ++i)
+  {
+    Worker& victim = *workers[(idx + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty())
+    {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      --queued;
+      stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+void WorkerPool::WorkerLoop(const unsigned int idx)
+{
+  currentPool = this;
+  currentWorker = idx;
+  Worker& w = *workers[idx];
+  while (true)
+  {
+    Task task;
+    bool stolen = false;
+    if (!Pop(idx, task, stolen))
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workAvailable.wait(lock, [this]{ return stop || queued > 0; });
+      if (stop && queued == 0) return;
+      continue;
+    }
+
+    std::exception_ptr taskError;
+    int64_t start = NowNs();
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      taskError = std::current_exception();
+    }
+    w.busyTime += NowNs() - start;
+    ++w.numTasks;
+    if (stolen) ++w.numSteals;
+
+    if (taskError)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = taskError;
+    }
+    if (--pending == 0)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      batchDone.notify_all();
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+std::vector<WorkerPool::WorkerStatistics> WorkerPool::GetStatistics() const
+{
+  double wallTime = (NowNs() - statisticsStart) * 1e-9;
+  std::vector<WorkerStatistics> ret;
+  for (unsigned int i = 0; i < workers.size(); ++i)
+  {
+    WorkerStatistics s;
+    s.busyTime = workers[i]->busyTime * 1e-9;
+    s.wallTime = wallTime;
+    s.numTasks = workers[i]->numTasks;
+    s.numSteals = workers[i]->numSteals;
+    ret.push_back(s);
+  }
+  return ret;
+}
+
+/////////////////////////////////////////////////
+void WorkerPool::ResetStatistics()
+{
+  for (unsigned int i = 0; i < workers.size(); ++i)
+  {
+    workers[i]->busyTime = 0;
+    workers[i]->numTasks = 0;
+    workers[i]->numSteals = 0;
+  }
+  statisticsStart = NowNs();
+}
+
+/////////////////////////////////////////////////
+std::ostream& collision_benchmark::operator<<
+  (std::ostream& o, const WorkerPool::WorkerStatistics& s)
+{
+  o << "utilization " << s.GetUtilization() * 100 << "% ("
+    << s.busyTime << "s of " << s.wallTime << "s), "
+    << s.numTasks << " tasks, " << s.numSteals << " stolen";
+  return o;
+}
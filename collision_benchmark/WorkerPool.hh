@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Persistent pool of worker threads with work stealing
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_WORKERPOOL_H
+#define COLLISION_BENCHMARK_WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace collision_benchmark
+{
+
+/**
+ * \brief Pool of persistent worker threads which can be used to run
+ * a batch of tasks in parallel.
+ *
+ * The threads are started in the constructor and live until the pool is
+ * destroyed, so there is no thread creation cost when a batch is run.
+ * RunAll() distributes a batch of tasks to the workers and blocks until
+ * all tasks of the batch have finished, so it acts as a barrier.
+ *
+ * Each worker has its own task queue. A worker takes tasks from the back
+ * of its own queue, and when it runs out of work it steals tasks from the
+ * front of the other workers' queues. A task may add continuation tasks to
+ * the current batch with Spawn(), which puts them on the local queue of the
+ * worker running the task. This way, long running jobs can be split into
+ * a chain of smaller tasks which can migrate to idle workers.
+ *
+ * The time each worker spends executing tasks is recorded, so that the
+ * utilization of the workers (and thereby load imbalance) can be inspected
+ * with GetStatistics().
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class WorkerPool
+{
+  public: typedef std::shared_ptr<WorkerPool> Ptr;
+  public: typedef std::shared_ptr<const WorkerPool> ConstPtr;
+
+  /// A task which can be run on a worker
+  public: typedef std::function<void()> Task;
+
+  /// Statistics of one worker since the last call of ResetStatistics()
+  /// (or since the pool was created).
+  public: struct WorkerStatistics
+  {
+    WorkerStatistics():
+      busyTime(0), wallTime(0), numTasks(0), numSteals(0) {}
+
+    /// \return fraction of the wall time the worker was executing tasks
+    double GetUtilization() const
+    {
+      return wallTime > 0 ? busyTime / wallTime : 0;
+    }
+
+    // time in seconds spent executing tasks
+    double busyTime;
+    // time in seconds since the statistics were reset
+    double wallTime;
+    // number of tasks executed
+    uint64_t numTasks;
+    // number of tasks which were stolen from other workers
+    uint64_t numSteals;
+  };
+
+  /// Constructor.
+  /// \param numWorkers number of worker threads to start. If 0, the number
+  ///   of hardware threads is used.
+  public: explicit WorkerPool(const unsigned int numWorkers = 0);
+
+  /// Destructor. Stops and joins all workers.
+  public: ~WorkerPool();
+
+  /// \return number of worker threads
+  public: unsigned int GetNumWorkers() const;
+
+  /// Runs all \e tasks on the workers and blocks until all of them, and all
+  /// tasks added with Spawn() in the meantime, have finished.
+  /// Calls from several threads are serialized.
+  /// If any of the tasks throws an exception, the first exception caught is
+  /// re-thrown in the calling thread, after all tasks have finished.
+  public: void RunAll(const std::vector<Task>& tasks);
+
+  /// Adds a task to the batch currently run by RunAll(). This is meant to be
+  /// called from within a task which is run by this pool: the new task
+  /// is put on the local queue of the calling worker, from where idle workers
+  /// can steal it. If called from any other thread, the task is added
+  /// to the queue of the first worker.
+  public: void Spawn(const Task& task);
+
+  /// \return the statistics of each worker
+  public: std::vector<WorkerStatistics> GetStatistics() const;
+
+  /// Resets the statistics of all workers
+  public: void ResetStatistics();
+
+  private: WorkerPool(const WorkerPool&);
+  private: WorkerPool& operator=(const WorkerPool&);
+
+  // A worker thread with its own task queue
+  private: struct Worker
+  {
+    Worker(): busyTime(0), numTasks(0), numSteals(0) {}
+    std::thread thread;
+    // tasks of this worker. The worker pops from the back,
+    // other workers steal from the front.
+    std::deque<Task> tasks;
+    // mutex protecting the tasks
+    std::mutex mutex;
+    // time in nanoseconds spent executing tasks
+    std::atomic<uint64_t> busyTime;
+    // number of tasks executed
+    std::atomic<uint64_t> numTasks;
+    // number of tasks stolen from other workers
+    std::atomic<uint64_t> numSteals;
+  };
+
+  // adds the task to the queue of worker \e idx
+  private: void Push(const unsigned int idx, const Task& task);
+
+  // gets the next task for worker \e idx, either from its own
+  // queue or stolen from another worker.
+  // \return false if no task could be found
+  private: bool Pop(const unsigned int idx, Task& task, bool& stolen);
+
+  // main loop of the worker thread with index \e idx
+  private: void WorkerLoop(const unsigned int idx);
+
+  // all workers
+  private: std::vector<std::unique_ptr<Worker>> workers;
+
+  // number of tasks of the current batch which have not finished yet
+  private: std::atomic<long> pending;
+
+  // number of tasks waiting in the queues
+  private: std::atomic<long> queued;
+
+  // first exception thrown by a task of the current batch
+  private: std::exception_ptr error;
+
+  // flag to stop the workers
+  private: bool stop;
+
+  // mutex protecting error and stop, and used to
+  // wait on workAvailable and batchDone
+  private: std::mutex mutex;
+
+  // signalled when tasks are added to the queues or when stopping
+  private: std::condition_variable workAvailable;
+
+  // signalled when the last task of a batch has finished
+  private: std::condition_variable batchDone;
+
+  // serializes calls of RunAll()
+  private: std::mutex runMutex;
+
+  // time (in nanoseconds since the clock's epoch) at which
+  // the statistics were last reset
+  private: std::atomic<int64_t> statisticsStart;
+};
+
+/// Prints the statistics of a worker
+std::ostream& operator<<(std::ostream& o,
+                         const WorkerPool::WorkerStatistics& s);
+
+}  // namespace collision_benchmark
+#endif  // COLLISION_BENCHMARK_WORKERPOOL_H
@@ -26,6 +26,9 @@
 #include <collision_benchmark/ControlServer.hh>
 #include <collision_benchmark/BasicTypes.hh>
 #include <collision_benchmark/TypeHelper.hh>
+#include <collision_benchmark/WorkerPool.hh>
+#include <collision_benchmark/LatencyHistogram.hh>
+#include <collision_benchmark/Trace.hh>
 
 #include <gazebo/gazebo.hh>
 #include <gazebo/transport/transport.hh>
@@ -33,9 +36,12 @@
 
 #include <boost/filesystem.hpp>
 
+#include <chrono>
 #include <string>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <atomic>
 
 namespace collision_benchmark
 {
@@ -104,6 +110,96 @@ class WorldManager
   public: typedef typename PhysicsWorldT::Ptr
             PhysicsWorldPtr;
 
+  /// Statistics which Update() records for one world while the step
+  /// statistics are enabled (see SetStepStatisticsEnabled()).
+  /// Recording is lock-free, so the worlds can be updated in parallel.
+  public: struct WorldStepRecorder
+  {
+    WorldStepRecorder(): numContacts(0), numUpdates(0), lastContacts(0) {}
+    // latency of one step of the world, in nanoseconds. See
+    // WorldStepStatistics::stepLatency for calls of Update() with
+    // more than one step.
+    LatencyHistogram stepLatency;
+    // sum of the number of contact points after each call of Update()
+    std::atomic<uint64_t> numContacts;
+    // number of calls of Update() in which the contacts were counted
+    std::atomic<uint64_t> numUpdates;
+    // number of contact points after the last call of Update()
+    std::atomic<uint64_t> lastContacts;
+    // buffer to count the contact points, re-used in each call of
+    // Update() so that counting does not allocate memory.
+    // Only used by the thread calling Update().
+    typename PhysicsWorldContactInterfaceT::ContactBuffer contacts;
+  };
+  public: typedef std::shared_ptr<WorldStepRecorder> WorldStepRecorderPtr;
+
+  /// Step statistics of one world, as returned by GetStepStatistics()
+  public: struct WorldStepStatistics
+  {
+    WorldStepStatistics(): numContacts(0), numUpdates(0), lastContacts(0) {}
+
+    /// \return the average number of contact points after a call
+    ///   of Update()
+    double GetContactsPerUpdate() const
+    {
+      return numUpdates > 0 ? numContacts / static_cast<double>(numUpdates)
+                            : 0;
+    }
+
+    // name of the world
+    std::string worldName;
+    // latency of one step of the world, in nanoseconds. Update() measures
+    // the time of all steps of one call and records the average for each
+    // of the steps. So if Update() is called with more than one step, the
+    // percentiles are those of these averages, and the variation between
+    // the steps of one call is not visible.
+    LatencyHistogram::Snapshot stepLatency;
+    // sum of the number of contact points after each call of Update()
+    uint64_t numContacts;
+    // number of calls of Update() in which the contacts were counted.
+    // Stays 0 for worlds which don't support the contact interface.
+    uint64_t numUpdates;
+    // number of contact points after the last call of Update()
+    uint64_t lastContacts;
+  };
+
+  /// Step statistics of all worlds, as returned by GetStepStatistics()
+  public: struct StepStatistics
+  {
+    // statistics of each world, at the same index as the world
+    std::vector<WorldStepStatistics> worlds;
+    // latency of MirrorWorld::Sync(), in nanoseconds
+    LatencyHistogram::Snapshot mirrorSyncLatency;
+  };
+
+  /// Immutable snapshot of all worlds maintained by the WorldManager.
+  /// A new snapshot is published each time the set of worlds changes,
+  /// so a snapshot obtained with GetWorldsSnapshot() can be used without
+  /// holding a lock of the WorldManager, even while worlds are added
+  /// concurrently.
+  ///
+  /// Besides the worlds, the snapshot contains the views of the worlds
+  /// as the different interfaces. They are resolved once when the world is
+  /// added, and are at the same index as the world in \e worlds. A view is
+  /// NULL if the world does not support the interface.
+  public: struct WorldsSnapshot
+  {
+    // all the worlds
+    std::vector<PhysicsWorldBaseInterface::Ptr> worlds;
+    // worlds as PhysicsWorldStateInterfaceT
+    std::vector<PhysicsWorldStateInterfacePtr> stateWorlds;
+    // worlds as PhysicsWorldModelInterfaceT
+    std::vector<PhysicsWorldModelInterfacePtr> modelWorlds;
+    // worlds as PhysicsWorldContactInterfaceT
+    std::vector<PhysicsWorldContactInterfacePtr> contactWorlds;
+    // worlds as PhysicsWorldT
+    std::vector<PhysicsWorldPtr> physicsWorlds;
+    // step statistics of the worlds. The recorders are shared
+    // with the following snapshots, so the statistics are kept
+    // when worlds are added.
+    std::vector<WorldStepRecorderPtr> stepRecorders;
+  };
+  public: typedef std::shared_ptr<const WorldsSnapshot> WorldsSnapshotConstPtr;
 
   public: typedef typename MirrorWorld::Ptr MirrorWorldPtr;
   public: typedef typename MirrorWorld::ConstPtr MirrorWorldConstPtr;
@@ -125,8 +221,12 @@ class WorldManager
                        const ControlServerPtr &_controlServer
                            = ControlServerPtr(),
                        const bool _activeControl = true):
+            worldsSnapshot(new WorldsSnapshot()),
             mirroredWorldIdx(-1),
-            controlServer(_controlServer)
+            controlServer(_controlServer),
+            updateStepBatch(0),
+            stepStatisticsEnabled(false),
+            stepStatisticsCountContacts(true)
   {
     this->SetMirrorWorld(_mirrorWorld);
     if (this->controlServer)
@@ -191,10 +291,11 @@ class WorldManager
    }
    this->mirrorWorld=_mirrorWorld;
    {
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     if (!this->worlds.empty())
+     std::lock_guard<std::mutex> lock(this->worldsMutex);
+     WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+     if (!snapshot->worlds.empty())
      {
-       this->mirrorWorld->SetOriginalWorld(worlds.front());
+       this->mirrorWorld->SetOriginalWorld(snapshot->worlds.front());
        this->mirroredWorldIdx=0;
      }
    }
@@ -216,25 +317,93 @@ class WorldManager
   ///         already exists.
   public: int AddPhysicsWorld(const PhysicsWorldBaseInterface::Ptr& _world)
   {
-    std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
+    std::lock_guard<std::mutex> lock(this->worldsMutex);
     if (GetWorld(_world->GetName()))
     {
       std::cerr << "World with this name already exists! " << std::endl;
       return -1;
     }
-    if (this->worlds.empty() && this->mirrorWorld)
+    WorldsSnapshotConstPtr oldSnapshot = GetWorldsSnapshot();
+    std::shared_ptr<WorldsSnapshot> snapshot(new WorldsSnapshot(*oldSnapshot));
+    snapshot->worlds.push_back(_world);
+    snapshot->stateWorlds.push_back(ToWorldWithState(_world));
+    snapshot->modelWorlds.push_back(ToWorldWithModel(_world));
+    snapshot->contactWorlds.push_back(ToWorldWithContact(_world));
+    snapshot->physicsWorlds.push_back(ToPhysicsWorld(_world));
+    snapshot->stepRecorders.push_back
+      (WorldStepRecorderPtr(new WorldStepRecorder()));
+    ReportFailedCasts(*snapshot, snapshot->worlds.size() - 1);
+    // publish the new snapshot. Readers which still
+    // hold the old one keep using it unchanged.
+    std::atomic_store(&this->worldsSnapshot,
+                      WorldsSnapshotConstPtr(snapshot));
+    if (oldSnapshot->worlds.empty() && this->mirrorWorld)
     {
       this->mirrorWorld->SetOriginalWorld(_world);
       this->mirroredWorldIdx=0;
     }
-    this->worlds.push_back(_world);
-    return this->worlds.size()-1;
+    return snapshot->worlds.size()-1;
+  }
+
+  // prints an error for each interface which world \e _index in
+  // \e snapshot could not be casted to
+  private: static void ReportFailedCasts(const WorldsSnapshot& snapshot,
+                                         const int _index)
+  {
+    if (!snapshot.modelWorlds[_index])
+    {
+      std::cerr<<"Cannot cast world " << _index << " to "
+               << "interface PhysicsWorldModelInterface<"
+               << GetTypeName<ModelID>()
+               << ", "<<GetTypeName<ModelPartID>()
+               << ", "<<GetTypeName<Vector3>()<<">" << std::endl;
+    }
+    if (!snapshot.contactWorlds[_index])
+    {
+      std::cerr<<"Cannot cast world " << _index << " to "
+               << "interface PhysicsWorldContactInterface<"
+               << GetTypeName<ModelID>()
+               << ", "<<GetTypeName<ModelPartID>()
+               << ", "<<GetTypeName<Vector3>()
+               << ", "<<GetTypeName<Wrench>()<<">" << std::endl;
+    }
+    if (!snapshot.physicsWorlds[_index])
+    {
+      std::cerr<<"Cannot cast world " << _index << " to "
+               << "interface PhysicsWorld<"
+               << GetTypeName<WorldState>()
+               << ", "<<GetTypeName<ModelID>()
+               << ", "<<GetTypeName<ModelPartID>()
+               << ", "<<GetTypeName<Vector3>()
+               << ", "<<GetTypeName<Wrench>()<<">" << std::endl;
+    }
   }
 
   public: bool SetMirroredWorld(const int _index)
   {
+    std::lock_guard<std::mutex> lock(this->worldsMutex);
+    return SetMirroredWorldNoLock(_index);
+  }
+
+  /// Returns a snapshot of all worlds. The snapshot is immutable and
+  /// can be accessed without holding a lock. Worlds which are added after
+  /// this call are not contained in the snapshot.
+  /// Obtaining the snapshot is not lock-free: the atomic shared_ptr
+  /// functions briefly lock an internal mutex of the standard library
+  /// and update the reference count. Call it once per pass over the
+  /// worlds rather than once per world.
+  /// Note that accessing the worlds in the snapshot asynchronously may lead to
+  /// thread safety issues. It is recommended to access the
+  /// worlds only in-between calls of Update().
+  public: WorldsSnapshotConstPtr GetWorldsSnapshot() const
+  {
+    return std::atomic_load(&this->worldsSnapshot);
+  }
 
-    if (_index < 0 ||  _index >= this->worlds.size())
+  // implementation of SetMirroredWorld(). worldsMutex has to be locked.
+  private: bool SetMirroredWorldNoLock(const int _index)
+  {
+    if (_index < 0 ||  _index >= GetWorldsSnapshot()->worlds.size())
       return false;
 
     // std::cout<<"Getting world at idx "<<_index<<std::endl;
@@ -252,30 +421,29 @@ class WorldManager
   /// Returns the original world which is mirrored by this class
   public: size_t GetNumWorlds() const
   {
-    std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-    return this->worlds.size();
+    return GetWorldsSnapshot()->worlds.size();
   }
 
 
   /// Returns the original world which is mirrored by this class
   public: PhysicsWorldBaseInterface::Ptr GetWorld(unsigned int _index) const
   {
-    std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-    GZ_ASSERT(_index >=0 && _index < this->worlds.size(),
+    WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+    GZ_ASSERT(_index >=0 && _index < snapshot->worlds.size(),
               "Index out of range");
-    if (_index >= this->worlds.size())
+    if (_index >= snapshot->worlds.size())
     {
       return PhysicsWorldBaseInterface::Ptr();
     }
-    return this->worlds.at(_index);
+    return snapshot->worlds.at(_index);
   }
 
   public: PhysicsWorldBaseInterface::Ptr GetWorld(const std::string& name) const
   {
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
+     WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
      for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it)
+          it = snapshot->worlds.begin();
+          it != snapshot->worlds.end(); ++it)
      {
        PhysicsWorldBaseInterface::Ptr w = *it;
        assert(w);
@@ -288,99 +456,48 @@ class WorldManager
   /// Note that accessing the returned worlds asynchronously may lead to
   /// thread safety issues. It is recommended to access the returned
   /// worlds only in-between calls of Update().
+  /// To avoid copying the vector, use GetWorldsSnapshot() instead.
   public: std::vector<PhysicsWorldBaseInterface::Ptr> GetWorlds() const
   {
-    std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-    std::vector<PhysicsWorldBaseInterface::Ptr> ret(this->worlds.begin(),
-                                                    this->worlds.end());
-    return ret;
+    return GetWorldsSnapshot()->worlds;
   }
 
   /// Returns all worlds which could be casted to PhysicsWorldModelInterfaceT.
+  /// Worlds which could not be casted are NULL.
   /// Note that accessing the returned worlds asynchronously may lead to
   /// thread safety issues. It is recommended to access the returned
   /// worlds only in-between calls of Update().
+  /// The worlds are casted once when they are added. To avoid copying the
+  /// vector, use GetWorldsSnapshot()->modelWorlds instead.
   public: std::vector<PhysicsWorldModelInterfacePtr>
           GetModelPhysicsWorlds() const
   {
-     std::vector<PhysicsWorldModelInterfacePtr> ret;
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     int i = 0;
-     for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it, ++i)
-     {
-       PhysicsWorldModelInterfacePtr w = ToWorldWithModel(*it);
-       if (!w)
-       {
-         std::cerr<<"Cannot cast world " << i << " to "
-                  << "interface PhysicsWorldModelInterface<"
-                  << GetTypeName<ModelID>()
-                  << ", "<<GetTypeName<ModelPartID>()
-                  << ", "<<GetTypeName<Vector3>()<<">" << std::endl;
-       }
-       ret.push_back(w);
-     }
-     return ret;
+     return GetWorldsSnapshot()->modelWorlds;
   }
 
   /// Returns all worlds which could be casted to PhysicsWorldContactInterfaceT.
+  /// Worlds which could not be casted are NULL.
   /// Note that accessing the returned worlds asynchronously may lead to
   /// thread safety issues. It is recommended to access the returned
   /// worlds only in-between calls of Update().
+  /// The worlds are casted once when they are added. To avoid copying the
+  /// vector, use GetWorldsSnapshot()->contactWorlds instead.
   public: std::vector<PhysicsWorldContactInterfacePtr>
           GetContactPhysicsWorlds() const
   {
-     std::vector<PhysicsWorldContactInterfacePtr> ret;
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     int i = 0;
-     for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it, ++i)
-     {
-       PhysicsWorldContactInterfacePtr
-         w = ToWorldWithContact(*it);
-       if (!w)
-       {
-         std::cerr<<"Cannot cast world " << i << " to "
-                  << "interface PhysicsWorldContactInterface<"
-                  << ", "<<GetTypeName<ModelID>()
-                  << ", "<<GetTypeName<ModelPartID>()
-                  << ", "<<GetTypeName<Vector3>()
-                  << ", "<<GetTypeName<Wrench>()<<">" << std::endl;
-       }
-       ret.push_back(w);
-     }
-     return ret;
+     return GetWorldsSnapshot()->contactWorlds;
   }
 
   /// Returns all worlds which could be casted to PhysicsWorldT.
+  /// Worlds which could not be casted are NULL.
   /// Note that accessing the returned worlds asynchronously may lead to
   /// thread safety issues. It is recommended to access the returned
   /// worlds only in-between calls of Update().
+  /// The worlds are casted once when they are added. To avoid copying the
+  /// vector, use GetWorldsSnapshot()->physicsWorlds instead.
   public: std::vector<PhysicsWorldPtr> GetPhysicsWorlds() const
   {
-     std::vector<PhysicsWorldPtr> ret;
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     int i = 0;
-     for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it, ++i)
-     {
-       PhysicsWorldPtr w = ToPhysicsWorld(*it);
-       if (!w)
-       {
-         std::cerr<<"Cannot cast world " << i << " to "
-                  << "interface PhysicsWorld<"
-                  << GetTypeName<WorldState>()
-                  << ", "<<GetTypeName<ModelID>()
-                  << ", "<<GetTypeName<ModelPartID>()
-                  << ", "<<GetTypeName<Vector3>()
-                  << ", "<<GetTypeName<Wrench>()<<">" << std::endl;
-       }
-       ret.push_back(w);
-     }
-     return ret;
+     return GetWorldsSnapshot()->physicsWorlds;
   }
 
   /// Calls PhysicsWorldModelInterface::AddModelFromFile
@@ -450,13 +567,36 @@ class WorldManager
   public: int SetBasicModelState(const ModelID& id,
                                  const BasicState& state)
   {
-    std::vector<bool> ret = CallOnAllWorldsWithModel
-      <bool, const ModelID&, const BasicState&>
-        (&Self::SetBasicModelStateCB, id, state);
+    WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
     int cnt = 0;
-    for (std::vector<bool>::iterator it = ret.begin(); it != ret.end(); ++it)
+    for (typename std::vector<PhysicsWorldModelInterfacePtr>::const_iterator
+         it = snapshot->modelWorlds.begin();
+         it != snapshot->modelWorlds.end(); ++it)
     {
-      if (*it) ++cnt;
+      const PhysicsWorldModelInterfacePtr& w = *it;
+      if (!w) ThrowNoModelInterface();
+      if (w->SetBasicModelState(id, state)) ++cnt;
+    }
+    return cnt;
+  }
+
+  /// Calls PhysicsWorldModelInterface::SetBasicModelStates on
+  /// all worlds, which sets the states of all models in \e states
+  /// in one pass per world. Assumes that all worlds use the same model names.
+  /// \return number of worlds in which all states were successfully set.
+  public: int SetBasicModelStates
+          (const std::vector<std::pair<ModelID, BasicState>>& states)
+  {
+    WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+    int cnt = 0;
+    for (typename std::vector<PhysicsWorldModelInterfacePtr>::const_iterator
+         it = snapshot->modelWorlds.begin();
+         it != snapshot->modelWorlds.end(); ++it)
+    {
+      const PhysicsWorldModelInterfacePtr& w = *it;
+      if (!w) ThrowNoModelInterface();
+      if (w->SetBasicModelStates(states) == static_cast<int>(states.size()))
+        ++cnt;
     }
     return cnt;
   }
@@ -506,10 +646,10 @@ class WorldManager
 
   public: void SetPaused(bool flag)
   {
-   std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-   for (std::vector<PhysicsWorldBaseInterface::Ptr>::iterator
-        it=this->worlds.begin();
-        it != this->worlds.end(); ++it)
+   WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+   for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
+        it = snapshot->worlds.begin();
+        it != snapshot->worlds.end(); ++it)
    {
      PhysicsWorldBaseInterface::Ptr w=*it;
      w->SetPaused(flag);
@@ -524,49 +664,201 @@ class WorldManager
   {
    std::cout << "WorldManager received request to set dynamics "
              << "enable to " << flag << std::endl;
-   std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-   for (std::vector<PhysicsWorldBaseInterface::Ptr>::iterator
-        it = this->worlds.begin();
-        it != this->worlds.end(); ++it)
+   WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+   for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
+        it = snapshot->worlds.begin();
+        it != snapshot->worlds.end(); ++it)
    {
      PhysicsWorldBaseInterface::Ptr w=*it;
      w->SetDynamicsEnabled(flag);
    }
   }
 
+  /// Enables or disables the parallel update mode. If enabled, Update()
+  /// runs PhysicsWorldBaseInterface::Update() of each world on a persistent
+  /// pool of worker threads and waits for all of them to finish before
+  /// the mirror world is synchronized. The worlds have to support being
+  /// updated concurrently to each other.
+  ///
+  /// The work is split per world and per batch of steps: after a world has
+  /// done \e stepBatch steps, the remaining steps are queued as a new task
+  /// which idle workers can steal. This balances the load when the cost
+  /// of the worlds' updates is uneven.
+  /// \param flag enable or disable parallel updates
+  /// \param numThreads number of worker threads. If 0, the number of
+  ///   hardware threads is used.
+  /// \param stepBatch maximum number of steps done by one task. If 0,
+  ///   each world does all steps of one call of Update() in one task.
+  public: void SetParallelUpdate(const bool flag,
+                                 const unsigned int numThreads = 0,
+                                 const unsigned int stepBatch = 0)
+  {
+    WorkerPool::Ptr newPool;
+    if (flag) newPool.reset(new WorkerPool(numThreads));
+    WorkerPool::Ptr oldPool;
+    {
+      std::lock_guard<std::mutex> lock(this->worldsMutex);
+      this->updateStepBatch = stepBatch;
+      oldPool = std::atomic_exchange(&this->updatePool, newPool);
+    }
+    // the old pool joins its workers when the last
+    // reference to it is released, outside the lock.
+  }
+
+  /// \return true if parallel update mode is enabled
+  public: bool IsParallelUpdate() const
+  {
+    return std::atomic_load(&this->updatePool).get() != NULL;
+  }
+
+  /// Returns the statistics of the workers which update the worlds in
+  /// parallel update mode, accumulated since the last call of
+  /// ResetUpdateStatistics(). The utilization of the workers
+  /// shows how well the load is balanced.
+  /// \return statistics of each worker, or empty vector if parallel
+  ///   update mode is disabled.
+  public: std::vector<WorkerPool::WorkerStatistics> GetUpdateStatistics() const
+  {
+    WorkerPool::Ptr pool = std::atomic_load(&this->updatePool);
+    if (!pool) return std::vector<WorkerPool::WorkerStatistics>();
+    return pool->GetStatistics();
+  }
+
+  /// Resets the statistics returned by GetUpdateStatistics()
+  public: void ResetUpdateStatistics()
+  {
+    WorkerPool::Ptr pool = std::atomic_load(&this->updatePool);
+    if (pool) pool->ResetStatistics();
+  }
+
+  /// Enables or disables the recording of step statistics in Update().
+  /// While enabled, Update() records the latency of the steps of each
+  /// world, the number of contact points of each world after the update
+  /// and the time taken by MirrorWorld::Sync(). The statistics can be read
+  /// with GetStepStatistics() at any time, also while Update() is running.
+  /// Counting the contacts requires the contacts of all worlds to be
+  /// retrieved after each update, so this is disabled by default.
+  /// \param flag enable or disable the step statistics
+  /// \param countContacts if false, the contacts are not counted, so that
+  ///   the statistics don't add to the time needed for Update().
+  public: void SetStepStatisticsEnabled(const bool flag,
+                                        const bool countContacts = true)
+  {
+    this->stepStatisticsCountContacts = countContacts;
+    this->stepStatisticsEnabled = flag;
+  }
+
+  /// \return true if step statistics are recorded
+  public: bool IsStepStatisticsEnabled() const
+  {
+    return this->stepStatisticsEnabled;
+  }
+
+  /// Returns the step statistics recorded since the last call of
+  /// ResetStepStatistics(), see also SetStepStatisticsEnabled().
+  public: StepStatistics GetStepStatistics() const
+  {
+    StepStatistics stats;
+    WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+    stats.worlds.resize(snapshot->worlds.size());
+    for (unsigned int i = 0; i < snapshot->worlds.size(); ++i)
+    {
+      const WorldStepRecorder& recorder = *snapshot->stepRecorders[i];
+      WorldStepStatistics& worldStats = stats.worlds[i];
+      worldStats.worldName = snapshot->worlds[i]->GetName();
+      worldStats.stepLatency = recorder.stepLatency.GetSnapshot();
+      worldStats.numContacts = recorder.numContacts;
+      worldStats.numUpdates = recorder.numUpdates;
+      worldStats.lastContacts = recorder.lastContacts;
+    }
+    stats.mirrorSyncLatency = this->mirrorSyncLatency.GetSnapshot();
+    return stats;
+  }
+
+  /// Resets the statistics returned by GetStepStatistics()
+  public: void ResetStepStatistics()
+  {
+    WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+    for (unsigned int i = 0; i < snapshot->stepRecorders.size(); ++i)
+    {
+      WorldStepRecorder& recorder = *snapshot->stepRecorders[i];
+      recorder.stepLatency.Reset();
+      recorder.numContacts = 0;
+      recorder.numUpdates = 0;
+      recorder.lastContacts = 0;
+    }
+    this->mirrorSyncLatency.Reset();
+  }
+
   /// Calls PhysicsWorld::Update(iter,force) on all worlds and subsequently
   /// calls MirrorWorld::Sync() and MirrorWorld::Update().
+  /// If parallel updates are enabled (see SetParallelUpdate()), the worlds
+  /// are updated concurrently.
+  /// If step statistics are enabled (see SetStepStatisticsEnabled()), they
+  /// are recorded for each world.
   public: void Update(int iter=1, bool force=false)
   {
-   // we cannot just lock the worldMutex with a lock here, because
-   // calling Update() may trigger the call of callbacks in this
-   // class, called by the ControlServer. ControlServer implementations
-   // may trigger the call of the callbacks from a different thread,
-   // therefore there will be a deadlock for accessing the worlds in
-   // the callback functions of this class. Only block the worlds
-   // vector while absolutey necessary.
+   // No lock is held while updating, because calling Update() may trigger
+   // the call of callbacks in this class, called by the ControlServer.
+   // ControlServer implementations may trigger the call of the callbacks
+   // from a different thread, and the callbacks access the worlds.
+   // The snapshot of the worlds can't change while we use it, and worlds
+   // which are added asynchronously will be updated in the next call.
    // std::cout<<"__________UPDATE__________"<<std::endl;
-   this->worldsMutex.lock();
-   int numWorlds=this->worlds.size();
-   this->worldsMutex.unlock();
-   for (int i=0; i< numWorlds; ++i)
+   TRACE_SCOPE("WorldManager::Update");
+   WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+   const bool recordStats = this->stepStatisticsEnabled;
+   WorkerPool::Ptr pool = std::atomic_load(&this->updatePool);
+   if (pool)
+   {
+     int stepBatch = this->updateStepBatch;
+     std::vector<WorkerPool::Task> tasks;
+     tasks.reserve(snapshot->worlds.size());
+     for (unsigned int i = 0; i < snapshot->worlds.size(); ++i)
+     {
+       // the snapshot keeps the histogram alive until all tasks finished
+       LatencyHistogram * latency = recordStats ?
+         &snapshot->stepRecorders[i]->stepLatency : NULL;
+       tasks.push_back(std::bind(&Self::UpdateWorldTask, pool.get(),
+                                 snapshot->worlds[i], latency,
+                                 iter, stepBatch, force));
+     }
+     // blocks until all worlds have been updated
+     pool->RunAll(tasks);
+   }
+   else
    {
-     PhysicsWorldBaseInterface::Ptr world;
+     for (unsigned int i = 0; i < snapshot->worlds.size(); ++i)
      {
-       // get the i'th world
-       std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-       // update vector size in case more worlds were
-       // added asynchronously
-       numWorlds=this->worlds.size();
-       // break loop if size of worlds has decreased
-       if (i >= numWorlds) break;
-       world=worlds[i];
+       LatencyHistogram * latency = recordStats ?
+         &snapshot->stepRecorders[i]->stepLatency : NULL;
+       UpdateWorld(snapshot->worlds[i], latency, iter, force);
+     }
+   }
+   if (recordStats && this->stepStatisticsCountContacts)
+   {
+     for (unsigned int i = 0; i < snapshot->contactWorlds.size(); ++i)
+     {
+       const PhysicsWorldContactInterfacePtr& w = snapshot->contactWorlds[i];
+       if (!w) continue;
+       WorldStepRecorder& recorder = *snapshot->stepRecorders[i];
+       w->FillContactBuffer(recorder.contacts);
+       uint64_t numContacts = recorder.contacts.GetNumContacts();
+       recorder.numContacts += numContacts;
+       ++recorder.numUpdates;
+       recorder.lastContacts = numContacts;
      }
-     world->Update(iter, force);
    }
    if (this->mirrorWorld)
    {
+     TRACE_SCOPE("MirrorWorld::Sync");
+     std::chrono::steady_clock::time_point start =
+       std::chrono::steady_clock::now();
      this->mirrorWorld->Sync();
+     if (recordStats)
+     {
+       this->mirrorSyncLatency.Record(ElapsedNs(start));
+     }
    }
    // std::cout<<"__________UPDATE END__________"<<std::endl;
   }
@@ -598,11 +890,12 @@ class WorldManager
                             const std::string& ext = "world",
                             const bool copyResources = true)
   {
+    TRACE_SCOPE("WorldManager::SaveAllWorlds");
     int fail = 0;
-    std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-    for (std::vector<PhysicsWorldBaseInterface::Ptr>::iterator
-         it = this->worlds.begin();
-         it != this->worlds.end(); ++it)
+    WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+    for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
+         it = snapshot->worlds.begin();
+         it != snapshot->worlds.end(); ++it)
     {
       PhysicsWorldBaseInterface::Ptr w=*it;
       boost::filesystem::path filename =
@@ -657,20 +950,13 @@ class WorldManager
   {
      std::cout << "WorldManager received SDF MODEL command"
                << std::endl;
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     for (std::vector<PhysicsWorldBaseInterface::Ptr>::iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it)
+     WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+     for (typename std::vector<PhysicsWorldModelInterfacePtr>::const_iterator
+          it = snapshot->modelWorlds.begin();
+          it != snapshot->modelWorlds.end(); ++it)
      {
-       PhysicsWorldModelInterfacePtr
-         w =ToWorldWithModel(*it);
-       if (!w)
-       {
-         THROW_EXCEPTION("Only support worlds which have the "
-                         << "interface PhysicsWorldModelInterface<"
-                         << GetTypeName<ModelID>()
-                         << ", "<<GetTypeName<ModelPartID>()<<">");
-       }
+       const PhysicsWorldModelInterfacePtr& w = *it;
+       if (!w) ThrowNoModelInterface();
 
        if (_isString)
        {
@@ -687,10 +973,10 @@ class WorldManager
   // it can be implemented here at some point
   /*public: void SetGravity(const float x, const float y, const float z)
    {
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     for (std::vector<PhysicsWorldBaseInterface::Ptr>::iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it)
+     WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+     for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
+          it = snapshot->worlds.begin();
+          it != snapshot->worlds.end(); ++it)
      {
          PhysicsWorldBaseInterface::Ptr w=*it;
          ...
@@ -706,7 +992,9 @@ class WorldManager
    */
   private: std::string ChangeMirrorWorld(const int ctrl)
   {
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
+     std::lock_guard<std::mutex> lock(this->worldsMutex);
+     const std::vector<PhysicsWorldBaseInterface::Ptr>& worlds =
+       GetWorldsSnapshot()->worlds;
        if (worlds.empty())
        {
          std::cerr<<"There are no worlds to be mirrored." << std::endl;
@@ -741,7 +1029,7 @@ class WorldManager
      }
 
      // update mirrored world
-     if (this->SetMirroredWorld(mirroredWorldIdx))
+     if (this->SetMirroredWorldNoLock(mirroredWorldIdx))
      {
        std::cout << "WorldManager: New world is "
                  << mirrorWorld->GetOriginalWorld()->GetName()
@@ -760,6 +1048,56 @@ class WorldManager
    }
 
 
+  // \return nanoseconds passed since \e start
+  private: static uint64_t ElapsedNs
+              (const std::chrono::steady_clock::time_point& start)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+      (std::chrono::steady_clock::now() - start).count();
+  }
+
+  // Does \e steps steps of world \e world. If \e latency is not NULL,
+  // the average latency of the steps is recorded in it once per step.
+  // The steps are not timed one by one, because that would mean calling
+  // Update() for each step.
+  private: static void UpdateWorld
+              (const PhysicsWorldBaseInterface::Ptr& world,
+               LatencyHistogram * latency,
+               const int steps,
+               const bool force)
+  {
+    TRACE_WORLD_SCOPE("Update", world->GetName());
+    if (!latency)
+    {
+      world->Update(steps, force);
+      return;
+    }
+    std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    world->Update(steps, force);
+    if (steps > 0) latency->Record(ElapsedNs(start) / steps, steps);
+  }
+
+  // Task for the parallel update: does up to \e stepBatch steps of world
+  // \e world and spawns a new task for the \e remaining steps.
+  private: static void UpdateWorldTask
+              (WorkerPool * pool,
+               const PhysicsWorldBaseInterface::Ptr& world,
+               LatencyHistogram * latency,
+               const int remaining,
+               const int stepBatch,
+               const bool force)
+  {
+    int steps = remaining;
+    if (stepBatch > 0 && stepBatch < remaining) steps = stepBatch;
+    UpdateWorld(world, latency, steps, force);
+    if (remaining > steps)
+    {
+      pool->Spawn(std::bind(&Self::UpdateWorldTask, pool, world, latency,
+                            remaining - steps, stepBatch, force));
+    }
+  }
+
   // Helper callback to call AddModelFromFile on the world
   private: static ModelLoadResult
                   AddModelFromFileCB(PhysicsWorldModelInterfaceT& w,
@@ -810,6 +1148,16 @@ class WorldManager
     return w.SetBasicModelState(id, state);
   }
 
+  // Helper which throws the exception for worlds which don't
+  // support the PhysicsWorldModelInterfaceT.
+  private: static void ThrowNoModelInterface()
+  {
+    THROW_EXCEPTION("Only support worlds which have the "
+                    << "interface PhysicsWorldModelInterface<"
+                    << GetTypeName<ModelID>()
+                    << ", "<<GetTypeName<ModelPartID>()<<">");
+  }
+
   // Helper function which calls a callback function on each of the worlds
   // after casting it to PhysicsWorldModelInterfaceT. Accumulates all return
   // values in a vector and returns it.
@@ -819,35 +1167,46 @@ class WorldManager
        Params... params)
   {
      std::vector<RetVal> ret;
-     std::lock_guard<std::recursive_mutex> lock(this->worldsMutex);
-     for (std::vector<PhysicsWorldBaseInterface::Ptr>::iterator
-          it = this->worlds.begin();
-          it != this->worlds.end(); ++it)
+     WorldsSnapshotConstPtr snapshot = GetWorldsSnapshot();
+     for (typename std::vector<PhysicsWorldModelInterfacePtr>::const_iterator
+          it = snapshot->modelWorlds.begin();
+          it != snapshot->modelWorlds.end(); ++it)
      {
-       PhysicsWorldModelInterfacePtr w = ToWorldWithModel(*it);
-       if (!w)
-       {
-         THROW_EXCEPTION("Only support worlds which have the "
-                         << "interface PhysicsWorldModelInterface<"
-                         << GetTypeName<ModelID>()
-                         << ", "<<GetTypeName<ModelPartID>()<<">");
-       }
+       const PhysicsWorldModelInterfacePtr& w = *it;
+       if (!w) ThrowNoModelInterface();
        RetVal r = callback(*w, std::forward<Params>(params)...);
        ret.push_back(r);
      }
      return ret;
   }
 
-  // all the worlds
-  private: std::vector<PhysicsWorldBaseInterface::Ptr> worlds;
-  // mutex protecting the worlds vector (not the worlds itself!)
-  private: mutable std::recursive_mutex worldsMutex;
+  // snapshot of all the worlds. Only accessed with std::atomic_load
+  // and std::atomic_store, replaced by a new snapshot when worlds are added.
+  // These functions are not lock-free (libstdc++ uses a mutex pool), but
+  // only hold their lock while copying the pointer.
+  private: WorldsSnapshotConstPtr worldsSnapshot;
+  // mutex serializing the modifications of the worlds (not the
+  // worlds itself!) and of the mirrored world. Readers of the
+  // worlds load the snapshot instead of locking it.
+  private: mutable std::mutex worldsMutex;
 
   private: MirrorWorldPtr mirrorWorld;
   private: int mirroredWorldIdx;
 
   private: ControlServerPtr controlServer;
 
+  // worker pool for parallel updates. NULL if parallel updates are disabled.
+  // Only accessed with std::atomic_load and std::atomic_exchange.
+  private: WorkerPool::Ptr updatePool;
+  // maximum number of steps per task in parallel updates. 0 for unlimited.
+  private: std::atomic<int> updateStepBatch;
+
+  // whether Update() records the step statistics
+  private: std::atomic<bool> stepStatisticsEnabled;
+  // whether Update() counts the contacts for the step statistics
+  private: std::atomic<bool> stepStatisticsCountContacts;
+  // latency of MirrorWorld::Sync() in Update()
+  private: LatencyHistogram mirrorSyncLatency;
 };
 
 }  // namespace collision_benchmark
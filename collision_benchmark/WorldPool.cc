@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Pool of empty worlds which are loaded ahead of time
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#include <collision_benchmark/WorldPool.hh>
+
+#include <iostream>
+#include <sstream>
+
+using collision_benchmark::WorldPool;
+using collision_benchmark::PhysicsWorldBaseInterface;
+
+/////////////////////////////////////////////////
+WorldPool::WorldPool(const std::string& _worldfile,
+                     const std::string& _namePrefix):
+  worldfile(_worldfile),
+  namePrefix(_namePrefix),
+  worldCount(0),
+  stop(false)
+{
+  filler = std::thread(&WorldPool::FillLoop, this);
+}
+
+/////////////////////////////////////////////////
+WorldPool::~WorldPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  fillNeeded.notify_all();
+  if (filler.joinable()) filler.join();
+}
+
+/////////////////////////////////////////////////
+void WorldPool::AddEngine(const WorldLoader::ConstPtr& loader,
+                          const unsigned int size)
+{
+  if (!loader) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    EngineQueue& queue = queues[loader->EngineName()];
+    queue.loader = loader;
+    queue.size = size;
+    queue.failed = false;
+  }
+  fillNeeded.notify_all();
+}
+
+/////////////////////////////////////////////////
+PhysicsWorldBaseInterface::Ptr WorldPool::Acquire(const std::string& engine)
+{
+  PhysicsWorldBaseInterface::Ptr world;
+  WorldLoader::ConstPtr loader;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, EngineQueue>::iterator it = queues.find(engine);
+    if (it == queues.end())
+    {
+      std::cerr << "Engine " << engine << " was not added to the world pool"
+                << std::endl;
+      return world;
+    }
+    EngineQueue& queue = it->second;
+    if (!queue.worlds.empty())
+    {
+      world = queue.worlds.front();
+      queue.worlds.pop_front();
+    }
+    else
+    {
+      loader = queue.loader;
+    }
+  }
+  // the background thread loads a replacement
+  fillNeeded.notify_all();
+
+  if (!world) world = LoadWorld(loader);
+  if (world)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    RemoveExpiredNoLock();
+    acquired[world] = engine;
+  }
+  return world;
+}
+
+/////////////////////////////////////////////////
+bool WorldPool::Release(const PhysicsWorldBaseInterface::Ptr& world)
+{
+  if (!world) return false;
+  std::string engine;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    AcquiredMap::iterator it = acquired.find(world);
+    if (it == acquired.end())
+    {
+      std::cerr << "World " << world->GetName()
+                << " was not acquired from this pool" << std::endl;
+      return false;
+    }
+    engine = it->second;
+    acquired.erase(it);
+  }
+
+  world->Clear();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queues[engine].worlds.push_back(world);
+  }
+  worldReady.notify_all();
+  return true;
+}
+
+/////////////////////////////////////////////////
+void WorldPool::WaitUntilFilled()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!GetEngineToFillNoLock().empty())
+  {
+    worldReady.wait(lock);
+  }
+}
+
+/////////////////////////////////////////////////
+unsigned int WorldPool::GetNumReady(const std::string& engine) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<std::string, EngineQueue>::const_iterator it = queues.find(engine);
+  if (it == queues.end()) return 0;
+  return it->second.worlds.size();
+}
+
+/////////////////////////////////////////////////
+PhysicsWorldBaseInterface::Ptr
+WorldPool::LoadWorld(const WorldLoader::ConstPtr& loader)
+{
+  std::stringstream name;
+  name << namePrefix << "_" << loader->EngineName() << "_" << worldCount++;
+  PhysicsWorldBaseInterface::Ptr world =
+    loader->LoadFromFile(worldfile, name.str());
+  if (!world)
+  {
+    std::cerr << "Could not load world " << worldfile << " for the pool "
+              << "with engine " << loader->EngineName() << std::endl;
+  }
+  return world;
+}
+
+/////////////////////////////////////////////////
+void WorldPool::RemoveExpiredNoLock()
+{
+  AcquiredMap::iterator it = acquired.begin();
+  while (it != acquired.end())
+  {
+    if (it->first.expired()) it = acquired.erase(it);
+    else ++it;
+  }
+}
+
+/////////////////////////////////////////////////
+std::string WorldPool::GetEngineToFillNoLock() const
+{
+  // fill the queue with the fewest ready worlds first, so that all
+  // engines get ready worlds soon after they have been added
+  std::string engine;
+  size_t minReady = 0;
+  for (std::map<std::string, EngineQueue>::const_iterator
+       it = queues.begin(); it != queues.end(); ++it)
+  {
+    const EngineQueue& queue = it->second;
+    if (queue.failed || !queue.loader || queue.worlds.size() >= queue.size)
+      continue;
+    if (engine.empty() || queue.worlds.size() < minReady)
+    {
+      engine = it->first;
+      minReady = queue.worlds.size();
+    }
+  }
+  return engine;
+}
+
+/////////////////////////////////////////////////
+void WorldPool::FillLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    std::string engine = GetEngineToFillNoLock();
+    while (!stop && engine.empty())
+    {
+      fillNeeded.wait(lock);
+      engine = GetEngineToFillNoLock();
+    }
+    if (stop) return;
+
+    WorldLoader::ConstPtr loader = queues[engine].loader;
+    lock.unlock();
+    PhysicsWorldBaseInterface::Ptr world = LoadWorld(loader);
+    lock.lock();
+
+    EngineQueue& queue = queues[engine];
+    if (world) queue.worlds.push_back(world);
+    else queue.failed = true;
+    worldReady.notify_all();
+  }
+}
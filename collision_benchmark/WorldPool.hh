@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Pool of empty worlds which are loaded ahead of time
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_WORLDPOOL_H
+#define COLLISION_BENCHMARK_WORLDPOOL_H
+
+#include <collision_benchmark/PhysicsWorld.hh>
+#include <collision_benchmark/WorldLoader.hh>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace collision_benchmark
+{
+
+/**
+ * \brief Keeps a number of empty worlds per physics engine loaded and
+ * ready, so that a world can be obtained without waiting for it to load.
+ *
+ * Loading a world (parsing the SDF, creating and initializing the world
+ * and its physics engine) can take seconds. The pool loads the worlds
+ * in a background thread, from the same world file for all engines,
+ * and keeps up to a given number of worlds ready for each engine.
+ * Acquire() hands out one of the ready worlds, and the background
+ * thread loads a replacement. If no world is ready, Acquire() loads
+ * one in the calling thread.
+ *
+ * Worlds which are not needed any more should be given back with
+ * Release(), which clears them with PhysicsWorldBaseInterface::Clear()
+ * so they can be handed out again. Settings changed on the world other
+ * than its models (e.g. the paused state) are not reset.
+ *
+ * The worlds are named \e namePrefix_engine_N. The prefix must be
+ * unique among all pools, and no other worlds must use these names.
+ * The world loaders must support loading worlds in the background thread
+ * while other worlds are in use, and while other threads load worlds.
+ * GazeboWorldLoader does so by loading only one world at a time.
+ *
+ * \author Jennifer Buehler
+ * \date May 2017
+ */
+class WorldPool
+{
+  public: typedef std::shared_ptr<WorldPool> Ptr;
+  public: typedef std::shared_ptr<const WorldPool> ConstPtr;
+
+  /// Constructor. Starts the background thread.
+  /// \param worldfile file of the empty world which is loaded for all
+  ///   engines, e.g. "worlds/empty.world"
+  /// \param namePrefix prefix of the names of the worlds
+  public: WorldPool(const std::string& worldfile,
+                    const std::string& namePrefix = "pool");
+
+  /// Destructor. Stops the background thread after it has finished
+  /// loading the current world.
+  public: ~WorldPool();
+
+  /// Adds the engine of \e loader to the pool and starts loading worlds
+  /// with it. If the engine was added before, only \e size is changed.
+  /// \param size number of worlds kept ready for this engine
+  public: void AddEngine(const WorldLoader::ConstPtr& loader,
+                         const unsigned int size);
+
+  /// \return a world of engine \e engine. A ready world is returned if
+  ///   there is one, otherwise a new world is loaded before returning.
+  ///   Returns NULL if the engine was not added or the world could
+  ///   not be loaded.
+  public: PhysicsWorldBaseInterface::Ptr Acquire(const std::string& engine);
+
+  /// Clears \e world and adds it to the ready worlds of its engine.
+  /// \return false if \e world was not acquired from this pool
+  public: bool Release(const PhysicsWorldBaseInterface::Ptr& world);
+
+  /// Blocks until the number of ready worlds of all engines
+  /// has reached the size given in AddEngine(), or loading failed.
+  public: void WaitUntilFilled();
+
+  /// \return number of ready worlds of engine \e engine
+  public: unsigned int GetNumReady(const std::string& engine) const;
+
+  private: WorldPool(const WorldPool&);
+  private: WorldPool& operator=(const WorldPool&);
+
+  // engine of the acquired worlds, by the owner of the world
+  private: typedef std::weak_ptr<PhysicsWorldBaseInterface> WorldWeakPtr;
+  private: typedef std::map<WorldWeakPtr, std::string,
+                            std::owner_less<WorldWeakPtr> > AcquiredMap;
+
+  // the ready worlds of one engine
+  private: struct EngineQueue
+  {
+    EngineQueue(): size(0), failed(false) {}
+    WorldLoader::ConstPtr loader;
+    std::deque<PhysicsWorldBaseInterface::Ptr> worlds;
+    // number of worlds to keep ready
+    unsigned int size;
+    // true if loading a world failed, in which
+    // case no more worlds are loaded
+    bool failed;
+  };
+
+  // loads a new world with \e loader.
+  // \return NULL if the world could not be loaded
+  private: PhysicsWorldBaseInterface::Ptr
+           LoadWorld(const WorldLoader::ConstPtr& loader);
+
+  // removes the worlds from \e acquired which have been deleted
+  // without being released. Needs a lock on mutex.
+  private: void RemoveExpiredNoLock();
+
+  // \return the engine of a queue which needs another world, or
+  //    empty string if all queues are filled. Needs a lock on mutex.
+  private: std::string GetEngineToFillNoLock() const;
+
+  // main loop of the background thread
+  private: void FillLoop();
+
+  // file of the empty world
+  private: const std::string worldfile;
+
+  // prefix of the world names
+  private: const std::string namePrefix;
+
+  // counter to generate unique world names
+  private: std::atomic<unsigned int> worldCount;
+
+  // the queue of each engine
+  private: std::map<std::string, EngineQueue> queues;
+
+  // Engine of each world which is currently acquired. The worlds are
+  // ordered by their owner, so that an entry can't be confused with
+  // another world at the same address after the world has been deleted
+  // without Release(). Such entries are removed in Acquire().
+  private: AcquiredMap acquired;
+
+  // flag to stop the background thread
+  private: bool stop;
+
+  // mutex protecting queues, acquired and stop
+  private: mutable std::mutex mutex;
+
+  // signalled when a queue needs another world or when stopping
+  private: std::condition_variable fillNeeded;
+
+  // signalled when a world was added to a queue or loading failed
+  private: std::condition_variable worldReady;
+
+  // the background thread
+  private: std::thread filler;
+};
+
+}  // namespace collision_benchmark
+#endif  // COLLISION_BENCHMARK_WORLDPOOL_H
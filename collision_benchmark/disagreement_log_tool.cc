@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+/* Desc: Lists the records of a disagreement log and creates
+ * the world files of a record
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+
+#include <collision_benchmark/DisagreementLog.hh>
+
+#include <sdf/sdf.hh>
+#include <ignition/math/Pose3.hh>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using collision_benchmark::DisagreementLogReader;
+using collision_benchmark::DisagreementRecord;
+using collision_benchmark::DisagreementWorldSummary;
+
+namespace po = boost::program_options;
+
+/////////////////////////////////////////////////
+// Sets the pose of all model elements named \e modelName which are
+// children of \e parent. If \e record has no rotation, only the
+// position is changed.
+void SetModelPose(const sdf::ElementPtr& parent,
+                  const std::string& modelName,
+                  const DisagreementRecord& record)
+{
+  if (!parent->HasElement("model")) return;
+  for (sdf::ElementPtr model = parent->GetElement("model"); model;
+       model = model->GetNextElement("model"))
+  {
+    if (model->Get<std::string>("name") != modelName) continue;
+    ignition::math::Pose3d pose = model->Get<ignition::math::Pose3d>("pose");
+    pose.Pos().Set(record.position[0], record.position[1],
+                   record.position[2]);
+    if ((record.rotation[0] != 0) || (record.rotation[1] != 0) ||
+        (record.rotation[2] != 0) || (record.rotation[3] != 0))
+    {
+      pose.Rot() = ignition::math::Quaterniond(record.rotation[3],
+                                               record.rotation[0],
+                                               record.rotation[1],
+                                               record.rotation[2]);
+    }
+    model->GetElement("pose")->Set(pose);
+  }
+}
+
+/////////////////////////////////////////////////
+// Writes the world files of record \e idx to \e outputDir.
+// The scene files are read relative to \e logDir.
+// \return number of worlds which could not be written
+int MaterializeRecord(const DisagreementLogReader& log,
+                      const uint64_t idx,
+                      const std::string& logDir,
+                      const std::string& outputDir)
+{
+  const DisagreementRecord& record = log.GetRecord(idx);
+  int fail = 0;
+  for (unsigned int w = 0; w < log.GetNumWorlds(); ++w)
+  {
+    boost::filesystem::path sceneFile =
+      boost::filesystem::path(logDir) / log.GetSceneFile(w);
+    sdf::SDFPtr sdf(new sdf::SDF());
+    sdf::init(sdf);
+    if (!sdf::readFile(sceneFile.string(), sdf) ||
+        !sdf->Root()->HasElement("world"))
+    {
+      std::cerr << "Could not read scene " << sceneFile << std::endl;
+      ++fail;
+      continue;
+    }
+    sdf::ElementPtr world = sdf->Root()->GetElement("world");
+    SetModelPose(world, log.GetModel2(), record);
+    // the state of the world overrides the poses of the models
+    if (world->HasElement("state"))
+    {
+      for (sdf::ElementPtr state = world->GetElement("state"); state;
+           state = state->GetNextElement("state"))
+      {
+        SetModelPose(state, log.GetModel2(), record);
+      }
+    }
+
+    std::stringstream filename;
+    filename << "fail_" << record.failure << "_"
+             << sceneFile.filename().string();
+    boost::filesystem::path outFile =
+      boost::filesystem::path(outputDir) / filename.str();
+    std::ofstream out(outFile.string().c_str());
+    if (!out)
+    {
+      std::cerr << "Could not write " << outFile << std::endl;
+      ++fail;
+      continue;
+    }
+    out << "<?xml version ='1.0'?>\n";
+    out << sdf->Root()->ToString("");
+    std::cout << "Written " << outFile << std::endl;
+  }
+  return fail;
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  std::string logFile;
+  std::string outputDir;
+  std::vector<uint64_t> records;
+
+  // Declare the supported options.
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "Produce help message")
+    ("list,l", "List all records of the log")
+    ("record,r", po::value<std::vector<uint64_t>>(&records)->multitoken(),
+      "Index of the record(s) for which to write the world files")
+    ("output,o", po::value<std::string>(&outputDir),
+      "Directory to write the world files to. Defaults to the directory \
+of the log, so that resources of the scene are found.")
+    ;
+  po::options_description desc_hidden("Positional options");
+  desc_hidden.add_options()
+    ("log", po::value<std::string>(&logFile), "Log file.")
+    ;
+
+  po::variables_map vm;
+
+  po::positional_options_description p;
+  p.add("log", 1);
+
+  po::options_description desc_composite;
+  desc_composite.add(desc).add(desc_hidden);
+
+  po::command_line_parser parser{argc, argv};
+  parser.options(desc_composite).positional(p);
+  po::parsed_options parsedOpt = parser.run();
+  po::store(parsedOpt, vm);
+  po::notify(vm);
+
+  if (vm.count("help") || !vm.count("log"))
+  {
+    std::cout << argv[0] <<" <log file> " << std::endl;
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  DisagreementLogReader log;
+  if (!log.Open(logFile)) return 1;
+
+  std::cout << "Log of models " << log.GetModel1() << " and "
+            << log.GetModel2() << " with " << log.GetNumWorlds()
+            << " worlds and " << log.GetNumRecords() << " records."
+            << std::endl;
+
+  if (vm.count("list"))
+  {
+    for (uint64_t i = 0; i < log.GetNumRecords(); ++i)
+    {
+      const DisagreementRecord& r = log.GetRecord(i);
+      std::cout << i << ": failure " << r.failure << ", cell " << r.cell
+                << ", position [" << r.position[0] << ", " << r.position[1]
+                << ", " << r.position[2] << "], rotation ["
+                << r.rotation[0] << ", " << r.rotation[1] << ", "
+                << r.rotation[2] << ", " << r.rotation[3] << "]"
+                << std::endl;
+      for (unsigned int w = 0; w < log.GetNumWorlds(); ++w)
+      {
+        const DisagreementWorldSummary& s = log.GetWorldSummary(i, w);
+        std::cout << "    " << log.GetSceneFile(w) << ": "
+                  << (s.colliding ? "colliding" : "not colliding")
+                  << ", " << s.numContacts << " contacts, max depth "
+                  << s.maxDepth << std::endl;
+      }
+    }
+  }
+
+  std::string logDir =
+    boost::filesystem::path(logFile).parent_path().string();
+  if (outputDir.empty()) outputDir = logDir;
+  int fail = 0;
+  for (std::vector<uint64_t>::const_iterator it = records.begin();
+       it != records.end(); ++it)
+  {
+    if (*it >= log.GetNumRecords())
+    {
+      std::cerr << "Record " << *it << " does not exist" << std::endl;
+      ++fail;
+      continue;
+    }
+    fail += MaterializeRecord(log, *it, logDir, outputDir);
+  }
+  return fail == 0 ? 0 : 1;
+}
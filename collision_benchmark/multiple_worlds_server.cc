@@ -25,6 +25,7 @@
 #include <collision_benchmark/GazeboHelpers.hh>
 #include <collision_benchmark/WorldManager.hh>
 #include <collision_benchmark/GazeboControlServer.hh>
+#include <collision_benchmark/Trace.hh>
 
 #include <collision_benchmark/GazeboMultipleWorldsServer.hh>
 #include <collision_benchmark/WorldLoader.hh>
@@ -35,6 +36,7 @@
 
 #include <boost/program_options.hpp>
 #include <atomic>
+#include <chrono>
 
 using collision_benchmark::PhysicsWorldBaseInterface;
 using collision_benchmark::PhysicsWorldStateInterface;
@@ -182,8 +184,24 @@ bool Init(const bool loadMirror,
 }
 
 
-// Runs the multiple worlds server
-bool Run()
+// Prints the step statistics of all worlds
+void PrintStepStatistics(const GzWorldManager::StepStatistics& stats)
+{
+  std::cout << "Step statistics:" << std::endl;
+  for (std::vector<GzWorldManager::WorldStepStatistics>::const_iterator
+       it = stats.worlds.begin(); it != stats.worlds.end(); ++it)
+  {
+    std::cout << "  " << it->worldName << ": step " << it->stepLatency
+              << ", " << it->GetContactsPerUpdate() << " contacts"
+              << std::endl;
+  }
+  std::cout << "  Mirror sync: " << stats.mirrorSyncLatency << std::endl;
+}
+
+// Runs the multiple worlds server.
+// \param statsInterval if > 0, the step statistics are printed
+//    every \e statsInterval seconds.
+bool Run(const double statsInterval)
 {
   GzWorldManager::Ptr worldManager = g_server->GetWorldManager();
   if (!worldManager) return false;
@@ -209,6 +227,13 @@ bool Run()
 
   worldManager->SetPaused(false);
 
+  if (statsInterval > 0)
+  {
+    worldManager->SetStepStatisticsEnabled(true);
+  }
+  std::chrono::steady_clock::time_point lastStats =
+    std::chrono::steady_clock::now();
+
   std::cout << "Now starting to update worlds."<<std::endl;
   int iter = 0;
   while(true)
@@ -217,17 +242,79 @@ bool Run()
     worldManager->Update(numSteps);
     LoopIter(iter);
     ++iter;
+
+    if ((statsInterval > 0) &&
+        (std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - lastStats).count() >= statsInterval))
+    {
+      PrintStepStatistics(worldManager->GetStepStatistics());
+      worldManager->ResetStepStatistics();
+      lastStats = std::chrono::steady_clock::now();
+    }
   }
   g_server->Stop();
   return true;
 }
 
+// Runs \e numSteps steps of all worlds as fast as possible, without waiting
+// for the user, and prints the throughput and the step statistics.
+// \param statsInterval if > 0, the step statistics are printed
+//    every \e statsInterval seconds and the contacts are counted as well.
+// \param numThreads if >= 0, the worlds are updated in parallel with
+//    this number of threads (0 for the number of hardware threads)
+bool RunBatch(const int numSteps, const double statsInterval,
+              const int numThreads)
+{
+  GzWorldManager::Ptr worldManager = g_server->GetWorldManager();
+  if (!worldManager) return false;
+
+  worldManager->SetPaused(false);
+  if (numThreads >= 0) worldManager->SetParallelUpdate(true, numThreads);
+  // the latency of the steps is always recorded. Counting the contacts
+  // slows down the updates, so it is only done if requested.
+  worldManager->SetStepStatisticsEnabled(true, statsInterval > 0);
+
+  std::cout << "Updating " << worldManager->GetNumWorlds() << " worlds for "
+            << numSteps << " steps";
+  if (worldManager->IsParallelUpdate()) std::cout << " in parallel";
+  std::cout << "." << std::endl;
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point lastStats = start;
+  for (int i = 0; i < numSteps; ++i)
+  {
+    worldManager->Update(1);
+    if ((statsInterval > 0) &&
+        (std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - lastStats).count() >= statsInterval))
+    {
+      std::cout << "Step " << i + 1 << " of " << numSteps << std::endl;
+      PrintStepStatistics(worldManager->GetStepStatistics());
+      lastStats = std::chrono::steady_clock::now();
+    }
+  }
+  double time = std::chrono::duration<double>
+    (std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "Done " << numSteps << " steps in " << time << "s: "
+            << (time > 0 ? numSteps / time : 0) << " steps/s, "
+            << (time > 0 ? numSteps * worldManager->GetNumWorlds() / time : 0)
+            << " world steps/s" << std::endl;
+  PrintStepStatistics(worldManager->GetStepStatistics());
+  g_server->Stop();
+  return true;
+}
+
 
 /////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
   std::vector<std::string> selectedEngines;
   std::vector<std::string> worldFiles;
+  double statsInterval = 0;
+  int numSteps = 0;
+  int numThreads = -1;
+  std::string traceFile;
 
   // description for engine options as stream so line doesn't go over 80 chars.
   std::stringstream descEngines;
@@ -245,6 +332,22 @@ int main(int argc, char **argv)
       descEngines.str().c_str())
     ("keep-name,k", "keep the names of the worlds as specified in the files. \
 Only works when no engines are specified with -e.")
+    ("stats-interval,s", po::value<double>(&statsInterval),
+      "Print the step latency and contacts of each world every \
+<arg> seconds.")
+    ("steps,n", po::value<int>(&numSteps),
+      "Batch mode: don't wait for the user, run <arg> steps as fast as \
+possible, print the throughput and exit.")
+    ("no-mirror", "Don't load the mirror world, so gzclient can't connect \
+and the worlds can't be controlled. Saves the time to update the mirror.")
+    ("no-control", "Only allow to view the worlds with gzclient, \
+not to modify them.")
+    ("trace,t", po::value<std::string>(&traceFile),
+      "Batch mode only: write a trace of the updates to <arg> \
+in the Chrome Trace Event format.")
+    ("threads,j", po::value<int>(&numThreads),
+      "Batch mode only: update the worlds in parallel with <arg> threads. \
+If 0, the number of hardware threads is used.")
     ;
   po::options_description desc_hidden("Positional options");
   desc_hidden.add_options()
@@ -296,9 +399,9 @@ Only works when no engines are specified with -e.")
   }
 
   // Initialize server
-  bool loadMirror = true;
+  bool loadMirror = !vm.count("no-mirror");
   bool enforceContactCalc=false;
-  bool allowControlViaMirror = true;
+  bool allowControlViaMirror = !vm.count("no-control");
   Init(loadMirror, allowControlViaMirror, enforceContactCalc);
   assert(g_server);
 
@@ -331,5 +434,17 @@ Only works when no engines are specified with -e.")
     }
   }
 
-  Run();
+  if (numSteps > 0)
+  {
+    if (!traceFile.empty()) collision_benchmark::Trace::Enable();
+    bool success = RunBatch(numSteps, statsInterval, numThreads);
+    if (!traceFile.empty())
+    {
+      collision_benchmark::Trace::Disable();
+      collision_benchmark::Trace::WriteChromeJSON(traceFile);
+    }
+    return success ? 0 : 1;
+  }
+
+  Run(statsInterval);
 }
@@ -0,0 +1,145 @@
+#include <collision_benchmark/DisagreementLog.hh>
+#include <collision_benchmark/BasicTypes.hh>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using collision_benchmark::DisagreementLogWriter;
+using collision_benchmark::DisagreementLogReader;
+using collision_benchmark::DisagreementRecord;
+using collision_benchmark::DisagreementWorldSummary;
+using collision_benchmark::BasicState;
+
+// returns the summaries of two worlds for record number \e i
+std::vector<DisagreementWorldSummary> GetSummaries(const unsigned int i)
+{
+  std::vector<DisagreementWorldSummary> worlds(2);
+  worlds[0].colliding = 1;
+  worlds[0].numContacts = i + 1;
+  worlds[0].maxDepth = 0.01 * i;
+  worlds[1].colliding = 0;
+  worlds[1].numContacts = 0;
+  worlds[1].maxDepth = 0;
+  return worlds;
+}
+
+// writes record number \e i with \e log
+bool WriteRecord(DisagreementLogWriter& log, const unsigned int i)
+{
+  BasicState state;
+  state.SetPosition(i, 2 * i, 3 * i);
+  if (i % 2 == 1) state.SetRotation(0, 0, 0, 1);
+  return log.Write(DisagreementLogWriter::CreateRecord(i, 10 * i, state),
+                   GetSummaries(i));
+}
+
+// checks that \e log contains the records 0 to \e numRecords - 1
+void CheckRecords(const DisagreementLogReader& log,
+                  const unsigned int numRecords)
+{
+  ASSERT_EQ(log.GetNumRecords(), numRecords);
+  ASSERT_EQ(log.GetNumWorlds(), 2u);
+  for (unsigned int i = 0; i < numRecords; ++i)
+  {
+    const DisagreementRecord& record = log.GetRecord(i);
+    EXPECT_EQ(record.failure, i);
+    EXPECT_EQ(record.cell, 10 * i);
+    EXPECT_DOUBLE_EQ(record.position[0], i);
+    EXPECT_DOUBLE_EQ(record.position[1], 2 * i);
+    EXPECT_DOUBLE_EQ(record.position[2], 3 * i);
+    EXPECT_DOUBLE_EQ(record.rotation[3], i % 2 == 1 ? 1 : 0);
+    std::vector<DisagreementWorldSummary> worlds = GetSummaries(i);
+    for (unsigned int w = 0; w < worlds.size(); ++w)
+    {
+      const DisagreementWorldSummary& summary = log.GetWorldSummary(i, w);
+      EXPECT_EQ(summary.colliding, worlds[w].colliding);
+      EXPECT_EQ(summary.numContacts, worlds[w].numContacts);
+      EXPECT_DOUBLE_EQ(summary.maxDepth, worlds[w].maxDepth);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////
+TEST(DisagreementLogTest, RoundTrip)
+{
+  const std::string filename =
+    (boost::filesystem::temp_directory_path() /
+     boost::filesystem::unique_path("disagreements_%%%%%%%%.log")).string();
+  std::vector<std::string> sceneFiles;
+  sceneFiles.push_back("scene_ode.world");
+  sceneFiles.push_back("scene_bullet.world");
+
+  // write a new log
+  {
+    DisagreementLogWriter log;
+    ASSERT_TRUE(log.Open(filename, "box", "sphere", sceneFiles));
+    ASSERT_TRUE(WriteRecord(log, 0));
+    ASSERT_TRUE(WriteRecord(log, 1));
+    // a record needs a summary for each world
+    ASSERT_FALSE(log.Write(DisagreementRecord(),
+                           std::vector<DisagreementWorldSummary>(1)));
+  }
+  DisagreementLogReader reader;
+  ASSERT_TRUE(reader.Open(filename));
+  EXPECT_EQ(reader.GetModel1(), "box");
+  EXPECT_EQ(reader.GetModel2(), "sphere");
+  EXPECT_EQ(reader.GetSceneFile(0), sceneFiles[0]);
+  EXPECT_EQ(reader.GetSceneFile(1), sceneFiles[1]);
+  CheckRecords(reader, 2);
+  reader.Close();
+
+  // append to the log with the same header
+  {
+    DisagreementLogWriter log;
+    ASSERT_TRUE(log.Open(filename, "box", "sphere", sceneFiles, true));
+    ASSERT_TRUE(WriteRecord(log, 2));
+  }
+  ASSERT_TRUE(reader.Open(filename));
+  CheckRecords(reader, 3);
+  reader.Close();
+
+  // an incomplete record at the end, as left by a killed process, is
+  // ignored by the reader and removed when appending
+  const uintmax_t completeSize = boost::filesystem::file_size(filename);
+  {
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::app);
+    const char partial[5] = {1, 2, 3, 4, 5};
+    out.write(partial, sizeof(partial));
+  }
+  ASSERT_TRUE(reader.Open(filename));
+  CheckRecords(reader, 3);
+  reader.Close();
+  {
+    DisagreementLogWriter log;
+    ASSERT_TRUE(log.Open(filename, "box", "sphere", sceneFiles, true));
+    EXPECT_EQ(boost::filesystem::file_size(filename), completeSize);
+    ASSERT_TRUE(WriteRecord(log, 3));
+  }
+  ASSERT_TRUE(reader.Open(filename));
+  CheckRecords(reader, 4);
+  reader.Close();
+
+  // a log with a different header is overwritten instead of appended to
+  {
+    DisagreementLogWriter log;
+    ASSERT_TRUE(log.Open(filename, "box", "cylinder", sceneFiles, true));
+    ASSERT_TRUE(WriteRecord(log, 0));
+  }
+  ASSERT_TRUE(reader.Open(filename));
+  EXPECT_EQ(reader.GetModel2(), "cylinder");
+  CheckRecords(reader, 1);
+  reader.Close();
+
+  boost::filesystem::remove(filename);
+}
+
+
+int main(int argc, char**argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
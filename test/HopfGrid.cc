@@ -0,0 +1,102 @@
+#include <test/HopfGrid.hh>
+
+#include <cmath>
+
+using collision_benchmark::Quaternion;
+
+/////////////////////////////////////////////
+unsigned int collision_benchmark::GetNumHopfOrientations
+              (const unsigned int resolution)
+{
+  const unsigned int nSide = 1u << resolution;
+  return 12 * nSide * nSide * 6 * nSide;
+}
+
+/////////////////////////////////////////////
+// Returns the coordinates of the HEALPix pixel centers of ring
+// \e ring in [1..4*nSide-1] as z = cos(theta) and the azimuth angles phi.
+void GetHealpixRing(const unsigned int nSide, const unsigned int ring,
+                    double& z, std::vector<double>& phis)
+{
+  phis.clear();
+  const double n = nSide;
+  if ((ring < nSide) || (ring > 3 * nSide))
+  {
+    // polar caps
+    const unsigned int i = (ring < nSide) ? ring : 4 * nSide - ring;
+    z = 1 - (i * i) / (3 * n * n);
+    if (ring > nSide) z = -z;
+    for (unsigned int j = 1; j <= 4 * i; ++j)
+      phis.push_back(M_PI / (2 * i) * (j - 0.5));
+  }
+  else
+  {
+    // equatorial belt, every other ring is shifted by half a pixel
+    z = 4.0 / 3 - (2.0 * ring) / (3 * n);
+    const double shift = ((ring - nSide + 1) % 2) / 2.0;
+    for (unsigned int j = 1; j <= 4 * nSide; ++j)
+      phis.push_back(M_PI / (2 * n) * (j - shift));
+  }
+}
+
+/////////////////////////////////////////////
+void collision_benchmark::GetHopfOrientations
+              (const unsigned int resolution,
+               std::vector<Quaternion>& orientations)
+{
+  orientations.clear();
+  orientations.reserve(GetNumHopfOrientations(resolution));
+
+  const unsigned int nSide = 1u << resolution;
+  const unsigned int numPsi = 6 * nSide;
+
+  double z;
+  std::vector<double> phis;
+  std::vector<Quaternion> circle;
+  circle.reserve(numPsi);
+  for (unsigned int ring = 1; ring < 4 * nSide; ++ring)
+  {
+    GetHealpixRing(nSide, ring, z, phis);
+    const double theta = acos(z);
+    const double cosTheta2 = cos(theta / 2);
+    const double sinTheta2 = sin(theta / 2);
+    for (std::vector<double>::const_iterator it = phis.begin();
+         it != phis.end(); ++it)
+    {
+      const double phi = *it;
+      circle.clear();
+      for (unsigned int k = 0; k < numPsi; ++k)
+      {
+        const double psi = 2 * M_PI / numPsi * (k + 0.5);
+        circle.push_back(Quaternion(cosTheta2 * sin(psi / 2),
+                                    sinTheta2 * cos(phi + psi / 2),
+                                    sinTheta2 * sin(phi + psi / 2),
+                                    cosTheta2 * cos(psi / 2)));
+      }
+      // start the circle at the orientation closest to the previous one,
+      // so that there is no jump between consecutive points on S^2.
+      // The circle is closed, so the last orientation of the circle
+      // is a neighbour of the first one.
+      unsigned int start = 0;
+      if (!orientations.empty())
+      {
+        const Quaternion& prev = orientations.back();
+        double maxDot = -1;
+        for (unsigned int k = 0; k < numPsi; ++k)
+        {
+          const Quaternion& q = circle[k];
+          // q and -q are the same orientation
+          const double dot = fabs(q.x * prev.x + q.y * prev.y +
+                                  q.z * prev.z + q.w * prev.w);
+          if (dot > maxDot)
+          {
+            maxDot = dot;
+            start = k;
+          }
+        }
+      }
+      for (unsigned int k = 0; k < numPsi; ++k)
+        orientations.push_back(circle[(start + k) % numPsi]);
+    }
+  }
+}
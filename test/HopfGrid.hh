@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2012-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/* Desc: Uniform grid of orientations based on the Hopf fibration of SO(3)
+ * Author: Jennifer Buehler
+ * Date: May 2017
+ */
+#ifndef COLLISION_BENCHMARK_TEST_HOPFGRID_H
+#define COLLISION_BENCHMARK_TEST_HOPFGRID_H
+
+#include <collision_benchmark/BasicTypes.hh>
+
+#include <vector>
+
+namespace collision_benchmark
+{
+  // Returns the number of orientations which GetHopfOrientations()
+  // generates for the given \e resolution.
+  unsigned int GetNumHopfOrientations(const unsigned int resolution);
+
+  // Generates a uniform grid of orientations in SO(3), following
+  // Yershova et al., "Generating Uniform Incremental Grids on SO(3)
+  // Using the Hopf Fibration". The grid is the product of a HEALPix grid
+  // on the sphere S^2 with 12 * 4^resolution points and a grid on the
+  // circle S^1 with 6 * 2^resolution points.
+  //
+  // The orientations are ordered such that consecutive orientations
+  // are close to each other: the points on S^2 are visited ring by
+  // ring, and the circle of each point on S^2 is traversed starting at
+  // the orientation closest to the last one of the previous circle.
+  //
+  // \param[in] resolution level of the grid, 0 yielding 72 orientations.
+  //    Each level increases the number of orientations by a factor of 8.
+  // \param[out] orientations the orientations (unit quaternions)
+  void GetHopfOrientations(const unsigned int resolution,
+                           std::vector<Quaternion>& orientations);
+}  // namespace collision_benchmark
+
+#endif  // COLLISION_BENCHMARK_TEST_HOPFGRID_H
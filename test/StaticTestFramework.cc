@@ -1,4 +1,5 @@
 #include <test/StaticTestFramework.hh>
+#include <test/HopfGrid.hh>
 
 #include <collision_benchmark/PrimitiveShape.hh>
 #include <collision_benchmark/SimpleTriMeshShape.hh>
@@ -11,9 +12,16 @@
 #include <gazebo/msgs/msgs.hh>
 
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <sstream>
 #include <thread>
 #include <atomic>
+#include <unordered_map>
 
 using collision_benchmark::Shape;
 using collision_benchmark::BasicState;
@@ -21,6 +29,38 @@ using collision_benchmark::Vector3;
 using collision_benchmark::Quaternion;
 using collision_benchmark::PhysicsWorldBaseInterface;
 
+// the world which is loaded with all engines
+const std::string emptyWorldFile = "test_worlds/void.world";
+
+// first line of the checkpoint files, including the version of the format
+const std::string checkpointHeader = "collision_benchmark_sweep_checkpoint 2";
+
+// adds \e size bytes at \e data to the FNV-1a hash \e h
+static void HashBytes(uint64_t& h, const void * data, const size_t size)
+{
+  const unsigned char * bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+}
+
+// adds \e d to the hash \e h
+static void HashDouble(uint64_t& h, const double d)
+{
+  HashBytes(h, &d, sizeof(d));
+}
+
+// adds \e str to the hash \e h
+static void HashString(uint64_t& h, const std::string& str)
+{
+  // the length separates consecutive strings
+  const uint64_t length = str.size();
+  HashBytes(h, &length, sizeof(length));
+  HashBytes(h, str.data(), str.size());
+}
+
 ////////////////////////////////////////////////////////////////
 void StaticTestFramework::Init()
 {
@@ -34,6 +74,8 @@ void StaticTestFramework::Init()
   // but not to manipulate the worlds.
   bool allowControlViaMirror = false;
   mServer->Init(mirrorName, allowControlViaMirror);
+  worldSetups.clear();
+  shardCache.clear();
 
 /*  GzWorldManager::ControlServerPtr controlServer =
     worldManager->GetControlServer();
@@ -56,10 +98,16 @@ void StaticTestFramework::InitMultipleEngines
   GzWorldManager::Ptr worldManager = mServer->GetWorldManager();
   ASSERT_NE(worldManager.get(), nullptr) << "No valid world manager created";
 
-  // world to load
-  std::string worldfile = "test_worlds/void.world";
-  int numWorlds = mServer->Load(worldfile, engines);
+  int numWorlds = mServer->Load(emptyWorldFile, engines);
   ASSERT_EQ(numWorlds, engines.size()) << "Could not prepare all engines";
+
+  for (int i = 0; i < numWorlds; ++i)
+  {
+    WorldSetup setup;
+    setup.engine = engines[i];
+    setup.worldname = worldManager->GetWorld(i)->GetName();
+    worldSetups.push_back(setup);
+  }
 }
 
 ////////////////////////////////////////////////////////////////
@@ -90,14 +138,18 @@ void StaticTestFramework::LoadOneEngine(const std::string& engine,
 
   int numWorldsInMgr = worldManager->GetNumWorlds();
 
-  // world to load
-  std::string worldfile = "test_worlds/void.world";
   for (int i = 0; i < numWorlds; ++i)
   {
     std::stringstream _worldname;
     _worldname << "world_" << i << "_" << engine;
     std::string worldname=_worldname.str();
-    mServer->Load(worldfile, engine, worldname);
+    if (mServer->Load(emptyWorldFile, engine, worldname) >= 0)
+    {
+      WorldSetup setup;
+      setup.engine = engine;
+      setup.worldname = worldname;
+      worldSetups.push_back(setup);
+    }
   }
   int numWorldsInMgrNew = worldManager->GetNumWorlds();
   ASSERT_EQ(numWorldsInMgrNew, numWorldsInMgr + numWorlds)
@@ -133,6 +185,12 @@ void StaticTestFramework::LoadShape(const Shape::Ptr& shape,
     ASSERT_EQ(mlRes.modelID, modelName)
       << "Model names should be equal";
   }
+
+  for (std::vector<WorldSetup>::iterator it = worldSetups.begin();
+       it != worldSetups.end(); ++it)
+  {
+    it->shapes.push_back(std::make_pair(modelName, shape));
+  }
 }
 
 ////////////////////////////////////////////////////////////////
@@ -165,6 +223,11 @@ void StaticTestFramework::LoadShape(const Shape::Ptr& shape,
 
   ASSERT_EQ(res.modelID, modelName)
     << "Model names should be equal";
+
+  if (worldIdx < worldSetups.size())
+  {
+    worldSetups[worldIdx].shapes.push_back(std::make_pair(modelName, shape));
+  }
 }
 
 
@@ -189,6 +252,148 @@ bool StaticTestFramework::GetAABBs(const std::string& modelName1,
 }
 
 
+////////////////////////////////////////////////////////////////
+bool StaticTestFramework::CreateShards(const unsigned int numShards,
+                                       std::vector<GzWorldManager::Ptr>& shards)
+{
+  shards.clear();
+  GzMultipleWorldsServer::Ptr mServer = GetServer();
+  if (!mServer || !mServer->GetWorldManager()) return false;
+  shards.push_back(mServer->GetWorldManager());
+
+  for (unsigned int k = 1; k < numShards; ++k)
+  {
+    // the shards are kept for the following sweeps, so the
+    // worlds of one shard only have to be loaded once
+    if (k > shardCache.size())
+    {
+      Shard newShard;
+      // the shards don't need a mirror world
+      newShard.worldManager.reset(new GzWorldManager());
+      shardCache.push_back(newShard);
+    }
+    Shard& shard = shardCache[k - 1];
+    if (!UpdateShard(k, shard)) return false;
+    shard.worldManager->SetDynamicsEnabled(false);
+    shard.worldManager->SetPaused(false);
+    shards.push_back(shard.worldManager);
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////
+bool StaticTestFramework::UpdateShard(const unsigned int k, Shard& shard)
+{
+  GzMultipleWorldsServer::Ptr mServer = GetServer();
+  for (unsigned int i = 0; i < worldSetups.size(); ++i)
+  {
+    const WorldSetup& setup = worldSetups[i];
+    std::stringstream worldname;
+    worldname << setup.worldname << "_shard_" << k;
+    if (i == shard.setups.size())
+    {
+      PhysicsWorldBaseInterface::Ptr world =
+        mServer->LoadWorld(emptyWorldFile, setup.engine, worldname.str());
+      if (!world || shard.worldManager->AddPhysicsWorld(world) < 0)
+      {
+        std::cerr << "Could not load world " << worldname.str()
+                  << " with engine " << setup.engine << std::endl;
+        return false;
+      }
+      WorldSetup shardSetup;
+      shardSetup.engine = setup.engine;
+      shardSetup.worldname = worldname.str();
+      shard.setups.push_back(shardSetup);
+    }
+
+    // models are only ever added to the worlds, so only the models
+    // which were added since the last update have to be loaded
+    WorldSetup& shardSetup = shard.setups[i];
+    if (shardSetup.engine != setup.engine ||
+        shardSetup.shapes.size() > setup.shapes.size())
+    {
+      std::cerr << "World " << worldname.str() << " does not match world "
+                << setup.worldname << std::endl;
+      return false;
+    }
+    GzWorldManager::PhysicsWorldModelInterfacePtr mWorld =
+      GzWorldManager::ToWorldWithModel(shard.worldManager->GetWorld(i));
+    if (!mWorld) return false;
+    for (unsigned int j = shardSetup.shapes.size();
+         j < setup.shapes.size(); ++j)
+    {
+      const std::pair<std::string, Shape::Ptr>& shape = setup.shapes[j];
+      if (mWorld->AddModelFromShape(shape.first, shape.second,
+                                    shape.second).opResult !=
+          collision_benchmark::SUCCESS)
+      {
+        std::cerr << "Could not load model " << shape.first
+                  << " into world " << worldname.str() << std::endl;
+        return false;
+      }
+      shardSetup.shapes.push_back(shape);
+    }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////
+bool StaticTestFramework::EvaluateCell(const GzWorldManager::Ptr& worldManager,
+                                       const std::string& modelName1,
+                                       const std::string& modelName2,
+                                       const BasicState& state,
+                                       const double minAgree,
+                                       const double zeroDepthTol,
+                                       bool& agree,
+                                       std::vector<std::string>& colliding,
+                                       std::vector<std::string>& notColliding,
+                                       double& maxContactDepth)
+{
+  // std::cout<<"Placing model 2 at "<<state<<std::endl;
+  int cnt = worldManager->SetBasicModelState(modelName2, state);
+  if (cnt < 0 || static_cast<size_t>(cnt) != worldManager->GetNumWorlds())
+    return false;
+
+  int numSteps=1;
+  worldManager->Update(numSteps);
+
+  return collision_benchmark::CollisionAgreement(modelName1, modelName2,
+                                                 worldManager, minAgree,
+                                                 zeroDepthTol, agree,
+                                                 colliding, notColliding,
+                                                 maxContactDepth);
+}
+
+////
+void StaticTestFramework::EvaluateCells
+                    (const GzWorldManager::Ptr& worldManager,
+                     const std::string& modelName1,
+                     const std::string& modelName2,
+                     const std::vector<BasicState>& cells,
+                     const unsigned int first,
+                     const unsigned int end,
+                     const double minAgree,
+                     const double zeroDepthTol,
+                     std::vector<CellResult>& results,
+                     std::atomic<bool>& abort)
+{
+  for (unsigned int i = first; i < end && !abort; ++i)
+  {
+    std::vector<std::string> colliding, notColliding;
+    double maxContactDepth;
+    bool agree;
+    if (!EvaluateCell(worldManager, modelName1, modelName2, cells[i],
+                      minAgree, zeroDepthTol, agree,
+                      colliding, notColliding, maxContactDepth))
+    {
+      abort = true;
+      return;
+    }
+    results[i].agree = agree;
+    results[i].evaluated = true;
+  }
+}
+
 ////////////////////////////////////////////////////////////////
 void StaticTestFramework::AABBTestWorldsAgreement(const std::string& modelName1,
                                    const std::string& modelName2,
@@ -198,32 +403,18 @@ void StaticTestFramework::AABBTestWorldsAgreement(const std::string& modelName1,
                                    const double zeroDepthTol,
                                    const bool interactive,
                                    const std::string& outputBasePath,
-                                   const std::string& outputSubdir)
+                                   const std::string& outputSubdir,
+                                   const unsigned int numShards)
 {
   ASSERT_GT(cellSizeFactor, 1e-07) << "Cell size factor too small";
 
-  GzMultipleWorldsServer::Ptr mServer = GetServer();
-  ASSERT_NE(mServer.get(), nullptr) << "Could not create and start server";
-  GzWorldManager::Ptr worldManager = mServer->GetWorldManager();
-  ASSERT_NE(worldManager.get(), nullptr) << "No valid world manager created";
-
-  worldManager->SetDynamicsEnabled(false);
-  worldManager->SetPaused(false);
+  GzWorldManager::Ptr worldManager;
+  collision_benchmark::GzAABB grid;
+  ASSERT_NO_FATAL_FAILURE(PrepareSweep(modelName1, modelName2, bbTol, false,
+                                       interactive, worldManager, grid));
 
   int numWorlds = worldManager->GetNumWorlds();
 
-  // set models to their initial pose
-
-  collision_benchmark::GzAABB aabb1, aabb2;
-  ASSERT_TRUE(GetAABBs(modelName1, modelName2, bbTol, aabb1, aabb2));
-
-  // std::cout<<"Got AABB 1: " <<  aabb1.min << ", " << aabb1.max << std::endl;
-  // std::cout<<"Got AABB 2: " <<  aabb2.min << ", " << aabb2.max << std::endl;
-
-  collision_benchmark::GzAABB grid = aabb1;
-  grid.min -= aabb2.size() / 2;
-  grid.max += aabb2.size() / 2;
-
   // place model 2 at start position
   BasicState bstate2;
   bstate2.SetPosition(Vector3(grid.min.X(), grid.min.Y(), grid.min.Z()));
@@ -237,6 +428,116 @@ void StaticTestFramework::AABBTestWorldsAgreement(const std::string& modelName1,
   std::cout << "cell size : " <<  cellSizeX << ", " <<cellSizeY << ", "
             << cellSizeZ << std::endl; */
 
+  // all states of model 2, in the order of the grid cells
+  std::vector<BasicState> cells;
+  double eps = 1e-07;
+  for (double x = grid.min.X(); x < grid.max.X()+eps; x += cellSizeX)
+  for (double y = grid.min.Y(); y < grid.max.Y()+eps; y += cellSizeY)
+  for (double z = grid.min.Z(); z < grid.max.Z()+eps; z += cellSizeZ)
+  {
+    BasicState state;
+    state.SetPosition(Vector3(x, y, z));
+    cells.push_back(state);
+  }
+
+  SweepWorldsAgreement(worldManager, modelName1, modelName2, cells,
+                       minAgree, zeroDepthTol, interactive,
+                       outputBasePath, outputSubdir, numShards);
+  std::cout<<"TwoModels test finished. "<<std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+void StaticTestFramework::AABBOrientationTestWorldsAgreement
+                                  (const std::string& modelName1,
+                                   const std::string& modelName2,
+                                   const float cellSizeFactor,
+                                   const unsigned int orientationResolution,
+                                   const double minAgree,
+                                   const double bbTol,
+                                   const double zeroDepthTol,
+                                   const bool interactive,
+                                   const std::string& outputBasePath,
+                                   const std::string& outputSubdir,
+                                   const unsigned int numShards)
+{
+  ASSERT_GT(cellSizeFactor, 1e-07) << "Cell size factor too small";
+
+  GzWorldManager::Ptr worldManager;
+  collision_benchmark::GzAABB grid;
+  ASSERT_NO_FATAL_FAILURE(PrepareSweep(modelName1, modelName2, bbTol, true,
+                                       interactive, worldManager, grid));
+
+  float cellSizeX = grid.size().X() * cellSizeFactor;
+  float cellSizeY = grid.size().Y() * cellSizeFactor;
+  float cellSizeZ = grid.size().Z() * cellSizeFactor;
+
+  std::vector<Quaternion> orientations;
+  collision_benchmark::GetHopfOrientations(orientationResolution,
+                                           orientations);
+
+  // all states of model 2. For each position, all orientations are
+  // visited, in alternating order for consecutive positions, so that
+  // consecutive states are always close to each other.
+  std::vector<BasicState> cells;
+  double eps = 1e-07;
+  bool reverse = false;
+  for (double x = grid.min.X(); x < grid.max.X()+eps; x += cellSizeX)
+  for (double y = grid.min.Y(); y < grid.max.Y()+eps; y += cellSizeY)
+  for (double z = grid.min.Z(); z < grid.max.Z()+eps; z += cellSizeZ)
+  {
+    for (unsigned int i = 0; i < orientations.size(); ++i)
+    {
+      BasicState state;
+      state.SetPosition(Vector3(x, y, z));
+      state.SetRotation(orientations[reverse ?
+                                     orientations.size() - 1 - i : i]);
+      cells.push_back(state);
+    }
+    reverse = !reverse;
+  }
+
+  std::cout << "Sweeping " << cells.size() / orientations.size()
+            << " positions with " << orientations.size()
+            << " orientations each." << std::endl;
+
+  SweepWorldsAgreement(worldManager, modelName1, modelName2, cells,
+                       minAgree, zeroDepthTol, interactive,
+                       outputBasePath, outputSubdir, numShards);
+  std::cout<<"Orientation test finished. "<<std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+void StaticTestFramework::PrepareSweep(const std::string& modelName1,
+                                       const std::string& modelName2,
+                                       const double bbTol,
+                                       const bool anyOrientation,
+                                       const bool interactive,
+                                       GzWorldManager::Ptr& worldManager,
+                                       collision_benchmark::GzAABB& grid)
+{
+  GzMultipleWorldsServer::Ptr mServer = GetServer();
+  ASSERT_NE(mServer.get(), nullptr) << "Could not create and start server";
+  worldManager = mServer->GetWorldManager();
+  ASSERT_NE(worldManager.get(), nullptr) << "No valid world manager created";
+
+  worldManager->SetDynamicsEnabled(false);
+  worldManager->SetPaused(false);
+
+  collision_benchmark::GzAABB aabb1, aabb2;
+  ASSERT_TRUE(GetAABBs(modelName1, modelName2, bbTol, aabb1, aabb2));
+
+  collision_benchmark::GzAABB::Vec3 margin = aabb2.size() / 2;
+  if (anyOrientation)
+  {
+    // model 2 can have any orientation, so its AABB can be as large as
+    // the sphere around its current AABB in all directions.
+    double radius2 = aabb2.size().Length() / 2;
+    margin = collision_benchmark::GzAABB::Vec3(radius2, radius2, radius2);
+  }
+  grid = aabb1;
+  grid.min -= margin;
+  grid.max += margin;
+
   if (interactive)
   {
     std::cout << "Now start gzclient if you would like "
@@ -244,141 +545,639 @@ void StaticTestFramework::AABBTestWorldsAgreement(const std::string& modelName1,
     std::cout << "Press [Enter] to continue."<<std::endl;
     getchar();
   }
+}
+
+////////////////////////////////////////////////////////////////
+void StaticTestFramework::SweepWorldsAgreement
+                    (const GzWorldManager::Ptr& worldManager,
+                     const std::string& modelName1,
+                     const std::string& modelName2,
+                     const std::vector<BasicState>& cells,
+                     const double minAgree,
+                     const double zeroDepthTol,
+                     const bool interactive,
+                     const std::string& outputBasePath,
+                     const std::string& outputSubdir,
+                     const unsigned int numShards)
+{
+  int numWorlds = worldManager->GetNumWorlds();
+
+  // copies of the worlds for the shards
+  std::vector<GzWorldManager::Ptr> shards(1, worldManager);
+  if ((numShards > 1) && !interactive)
+  {
+    if (static_cast<int>(worldSetups.size()) != numWorlds)
+    {
+      std::cout << "Worlds were not loaded with the StaticTestFramework, "
+                << "so they can't be copied for the shards. "
+                << "Running with only one shard." << std::endl;
+    }
+    else
+    {
+      ASSERT_TRUE(CreateShards(numShards, shards))
+        << "Could not create " << numShards << " shards";
+    }
+  }
 
   // start the update loop
   std::cout << "Now starting to update worlds."<<std::endl;
 
+  // a new log of disagreements is started for each sweep
+  disagreementLog.reset();
+
+  // resume from the last checkpoint of this sweep, if there is one
+  const std::string checkpointFile = GetCheckpointFile();
+  const uint64_t sweepHash = checkpointFile.empty() ? 0 :
+    GetSweepHash(modelName1, modelName2, cells, minAgree, zeroDepthTol);
+  unsigned int firstCell = 0;
+  std::vector<unsigned int> failedCells;
+  if (!checkpointFile.empty() && resumeFromCheckpoint &&
+      ReadCheckpoint(checkpointFile, sweepHash, cells.size(), numWorlds,
+                     firstCell, failedCells))
+  {
+    std::cout << "Resuming sweep from checkpoint " << checkpointFile
+              << " at cell " << firstCell << " of " << cells.size()
+              << std::endl;
+    if (!failedCells.empty())
+    {
+      ADD_FAILURE() << failedCells.size() << " disagreements were found "
+                    << "before resuming, in cells "
+                    << collision_benchmark::VectorToString(failedCells);
+    }
+  }
+
+  // the cells are processed in blocks, and the progress is saved after
+  // each block. Without checkpoints, all cells are in one block.
+  const unsigned int blockSize = checkpointFile.empty() ?
+    cells.size() : std::max(1u, checkpointBlockSize);
+
   int msSleep = 0;  // delay for running the test
-  double eps = 1e-07;
   unsigned int itCnt = 0;
-  unsigned int failCnt = 0;
-  for (double x = grid.min.X(); x < grid.max.X()+eps; x += cellSizeX)
-  for (double y = grid.min.Y(); y < grid.max.Y()+eps; y += cellSizeY)
-  for (double z = grid.min.Z(); z < grid.max.Z()+eps; z += cellSizeZ)
+  unsigned int failCnt = failedCells.size();
+  std::vector<CellResult> results(cells.size());
+  for (unsigned int blockStart = firstCell; blockStart < cells.size();
+       blockStart += blockSize)
   {
-    ++itCnt;
-    // std::cout<<"Placing model 2 at "<<x<<", "<<y<<", "<<z<<std::endl;
-    bstate2.position.x = x;
-    bstate2.position.y = y;
-    bstate2.position.z = z;
-    cnt = worldManager->SetBasicModelState(modelName2, bstate2);
-    ASSERT_EQ(cnt, numWorlds) << "All worlds should have been updated";
-
-    int numSteps=1;
-    worldManager->Update(numSteps);
-    if (msSleep > 0) gazebo::common::Time::MSleep(msSleep);
+    const unsigned int blockEnd =
+      std::min(static_cast<unsigned int>(cells.size()),
+               blockStart + blockSize);
 
-    std::vector<std::string> colliding, notColliding;
-    double maxContactDepth;
-    ASSERT_TRUE(collision_benchmark::CollisionState(modelName1, modelName2,
-                                                    worldManager, colliding,
-                                                    notColliding,
-                                                    maxContactDepth));
-# if 0
-    // For TESTING: stop at every colliding state
-    int stopX = 5;
-    if (!colliding.empty()&& ((itCnt % stopX) == 0))
+    // with several shards, evaluate all cells of the block in parallel
+    // first. Each shard gets a contiguous part of the block, so that
+    // consecutive cells (which are close to each other) are evaluated
+    // in the same worlds.
+    if (shards.size() > 1)
     {
-      std::stringstream str;
-      str << std::endl << "Colliding: " << std::endl << " ------ " << std::endl;
-      for (std::vector<std::string>::iterator it = colliding.begin();
-           it != colliding.end(); ++it)
+      std::cout << "Evaluating cells " << blockStart << " to " << blockEnd
+                << " of " << cells.size() << " with "
+                << shards.size() << " shards." << std::endl;
+      std::atomic<bool> abort(false);
+      std::vector<std::thread> threads;
+      for (unsigned int k = 0; k < shards.size(); ++k)
       {
-        if (it != colliding.begin()) str << std::endl;
-        std::vector<GzContactInfoPtr> contacts =
-          collision_benchmark::GetContactInfo(modelName1, modelName2,
-                                              *it, worldManager);
-        str << *it << ": " << VectorPtrToString(contacts);
+        unsigned int first =
+          blockStart + (blockEnd - blockStart) * k / shards.size();
+        unsigned int end =
+          blockStart + (blockEnd - blockStart) * (k + 1) / shards.size();
+        threads.push_back(std::thread(&StaticTestFramework::EvaluateCells,
+                                      shards[k], modelName1, modelName2,
+                                      std::cref(cells), first, end,
+                                      minAgree, zeroDepthTol,
+                                      std::ref(results), std::ref(abort)));
       }
-      RefreshClient(5);
-      collision_benchmark::UpdateUntilEnter(worldManager);
+      for (unsigned int k = 0; k < threads.size(); ++k) threads[k].join();
+      ASSERT_FALSE(abort) << "Not all cells could be evaluated";
     }
+
+    for (unsigned int i = blockStart; i < blockEnd; ++i)
+    {
+      ++itCnt;
+      // cells which the shards found to agree need no further checking
+      if ((shards.size() > 1) && results[i].evaluated && results[i].agree)
+        continue;
+
+      // (re-)evaluate the cell with the main worlds, so that the worlds
+      // are in the state of this cell to view or save them.
+      std::vector<std::string> colliding, notColliding;
+      double maxContactDepth;
+      bool agree;
+      ASSERT_TRUE(EvaluateCell(worldManager, modelName1, modelName2, cells[i],
+                               minAgree, zeroDepthTol, agree,
+                               colliding, notColliding, maxContactDepth))
+        << "Could not evaluate cell " << cells[i];
+      if (msSleep > 0) gazebo::common::Time::MSleep(msSleep);
+# if 0
+      // For TESTING: stop at every colliding state
+      int stopX = 5;
+      if (!colliding.empty()&& ((itCnt % stopX) == 0))
+      {
+        std::stringstream str;
+        str << std::endl << "Colliding: " << std::endl
+            << " ------ " << std::endl;
+        for (std::vector<std::string>::iterator it = colliding.begin();
+             it != colliding.end(); ++it)
+        {
+          if (it != colliding.begin()) str << std::endl;
+          std::vector<GzContactInfoPtr> contacts =
+            collision_benchmark::GetContactInfo(modelName1, modelName2,
+                                                *it, worldManager);
+          str << *it << ": " << VectorPtrToString(contacts);
+        }
+        RefreshClient(5);
+        collision_benchmark::UpdateUntilEnter(worldManager);
+      }
 #endif
 
-    if (!colliding.empty() && (fabs(maxContactDepth) < zeroDepthTol))
+      // surface contacts are included in the agreement, because
+      // engines are actually allowed to disagree about them.
+      if (agree) continue;
+
+      // in case of disagreement, all worlds have been queried
+      size_t total = colliding.size() + notColliding.size();
+
+      ASSERT_EQ(numWorlds, total) << "All worlds must have voted";
+      ASSERT_GT(total, 0 ) << "This should have been caught before";
+
+      ReportDisagreement(worldManager, modelName1, modelName2,
+                         colliding, notColliding, cells[i], i, failCnt,
+                         interactive, outputBasePath, outputSubdir);
+      failedCells.push_back(i);
+      ++failCnt;
+    }
+
+    if (!checkpointFile.empty() && (blockEnd < cells.size()) &&
+        !WriteCheckpoint(checkpointFile, sweepHash, cells.size(), numWorlds,
+                         blockEnd, failedCells))
+    {
+      std::cerr << "Could not write checkpoint " << checkpointFile
+                << std::endl;
+    }
+  }
+
+  // the sweep is complete, so it must not be resumed any more
+  if (!checkpointFile.empty()) std::remove(checkpointFile.c_str());
+}
+
+////////////////////////////////////////////////////////////////
+void StaticTestFramework::SetCheckpoint(const std::string& checkpointDir,
+                                        const bool resume,
+                                        const unsigned int blockSize)
+{
+  checkpointPath = checkpointDir;
+  resumeFromCheckpoint = resume;
+  checkpointBlockSize = blockSize;
+}
+
+////////////////////////////////////////////////////////////////
+std::string StaticTestFramework::GetCheckpointFile() const
+{
+  if (checkpointPath.empty()) return "";
+  // one checkpoint per test, named after the test
+  std::string name = "sweep";
+  const ::testing::TestInfo * testInfo =
+    ::testing::UnitTest::GetInstance()->current_test_info();
+  if (testInfo)
+    name = std::string(testInfo->test_case_name()) + "." + testInfo->name();
+  std::replace(name.begin(), name.end(), '/', '_');
+  return checkpointPath + "/" + name + ".checkpoint";
+}
+
+////////////////////////////////////////////////////////////////
+uint64_t StaticTestFramework::GetSweepHash
+                    (const std::string& modelName1,
+                     const std::string& modelName2,
+                     const std::vector<BasicState>& cells,
+                     const double minAgree,
+                     const double zeroDepthTol) const
+{
+  uint64_t h = 14695981039346656037ULL;
+  HashString(h, emptyWorldFile);
+  for (std::vector<WorldSetup>::const_iterator it = worldSetups.begin();
+       it != worldSetups.end(); ++it)
+  {
+    HashString(h, it->engine);
+    HashString(h, it->worldname);
+    for (std::vector<std::pair<std::string, Shape::Ptr> >::const_iterator
+         sIt = it->shapes.begin(); sIt != it->shapes.end(); ++sIt)
     {
-      // if contacts were found but they are just surface contacts,
-      // skip this because engines are actually allowed to disagree.
-      // std::cout << "DEBUG-INFO: Not considering case of maximum depth 0 "
-      //          << "because this is a borderline case" << std::endl;
-      continue;
+      HashString(h, sIt->first);
+      const Shape::Ptr& shape = sIt->second;
+      const int type = shape ? shape->GetType() : -1;
+      HashBytes(h, &type, sizeof(type));
+      if (!shape) continue;
+      const Shape::Pose3& pose = shape->GetPose();
+      HashDouble(h, pose.Pos().X());
+      HashDouble(h, pose.Pos().Y());
+      HashDouble(h, pose.Pos().Z());
+      HashDouble(h, pose.Rot().X());
+      HashDouble(h, pose.Rot().Y());
+      HashDouble(h, pose.Rot().Z());
+      HashDouble(h, pose.Rot().W());
     }
+  }
+  HashString(h, modelName1);
+  HashString(h, modelName2);
+  for (std::vector<BasicState>::const_iterator it = cells.begin();
+       it != cells.end(); ++it)
+  {
+    HashDouble(h, it->position.x);
+    HashDouble(h, it->position.y);
+    HashDouble(h, it->position.z);
+    HashDouble(h, it->rotation.x);
+    HashDouble(h, it->rotation.y);
+    HashDouble(h, it->rotation.z);
+    HashDouble(h, it->rotation.w);
+  }
+  HashDouble(h, minAgree);
+  HashDouble(h, zeroDepthTol);
+  return h;
+}
+
+////////////////////////////////////////////////////////////////
+bool StaticTestFramework::WriteCheckpoint
+                    (const std::string& filename,
+                     const uint64_t sweepHash,
+                     const unsigned int numCells,
+                     const unsigned int numWorlds,
+                     const unsigned int nextCell,
+                     const std::vector<unsigned int>& failedCells)
+{
+  // write to a temporary file first and rename it, so that there always
+  // is a complete checkpoint, even if the process is killed while writing.
+  const std::string tmpFilename = filename + ".tmp";
+  {
+    std::ofstream out(tmpFilename.c_str());
+    if (!out) return false;
+    out << checkpointHeader << std::endl
+        << "sweep " << sweepHash << std::endl
+        << "cells " << numCells << std::endl
+        << "worlds " << numWorlds << std::endl
+        << "next " << nextCell << std::endl
+        << "failures " << failedCells.size() << std::endl;
+    for (std::vector<unsigned int>::const_iterator it = failedCells.begin();
+         it != failedCells.end(); ++it)
+    {
+      out << *it << std::endl;
+    }
+    out.close();
+    if (!out) return false;
+  }
+  return std::rename(tmpFilename.c_str(), filename.c_str()) == 0;
+}
+
+////////////////////////////////////////////////////////////////
+bool StaticTestFramework::ReadCheckpoint
+                    (const std::string& filename,
+                     const uint64_t sweepHash,
+                     const unsigned int numCells,
+                     const unsigned int numWorlds,
+                     unsigned int& nextCell,
+                     std::vector<unsigned int>& failedCells)
+{
+  std::ifstream in(filename.c_str());
+  if (!in) return false;
+
+  std::string header, key[5];
+  uint64_t fileSweepHash;
+  unsigned int fileNumCells, fileNumWorlds, fileNextCell, numFailures;
+  std::getline(in, header);
+  in >> key[0] >> fileSweepHash >> key[1] >> fileNumCells
+     >> key[2] >> fileNumWorlds >> key[3] >> fileNextCell
+     >> key[4] >> numFailures;
+  if (!in || (header != checkpointHeader) || (key[0] != "sweep") ||
+      (key[1] != "cells") || (key[2] != "worlds") || (key[3] != "next") ||
+      (key[4] != "failures"))
+  {
+    std::cerr << "Checkpoint " << filename << " is invalid" << std::endl;
+    return false;
+  }
+  if (fileSweepHash != sweepHash)
+  {
+    std::cerr << "Checkpoint " << filename << " was written for a sweep "
+              << "with different parameters, not resuming it" << std::endl;
+    return false;
+  }
+  if ((fileNumCells != numCells) || (fileNumWorlds != numWorlds) ||
+      (fileNextCell > numCells))
+  {
+    std::cerr << "Checkpoint " << filename << " was written for a "
+              << "different sweep (" << fileNumCells << " cells, "
+              << fileNumWorlds << " worlds)" << std::endl;
+    return false;
+  }
+
+  std::vector<unsigned int> failures(numFailures);
+  for (unsigned int i = 0; i < numFailures; ++i) in >> failures[i];
+  if (!in)
+  {
+    std::cerr << "Checkpoint " << filename << " is incomplete" << std::endl;
+    return false;
+  }
+  nextCell = fileNextCell;
+  failedCells.swap(failures);
+  return true;
+}
 
-    size_t total = colliding.size() + notColliding.size();
+////////////////////////////////////////////////////////////////
+void StaticTestFramework::ReportDisagreement
+                    (const GzWorldManager::Ptr& worldManager,
+                     const std::string& modelName1,
+                     const std::string& modelName2,
+                     const std::vector<std::string>& colliding,
+                     const std::vector<std::string>& notColliding,
+                     const BasicState& state,
+                     const uint64_t cell,
+                     const unsigned int failCnt,
+                     const bool interactive,
+                     const std::string& outputBasePath,
+                     const std::string& outputSubdir)
+{
+  size_t total = colliding.size() + notColliding.size();
+  double negative = notColliding.size() / (double) total;
+  double positive= colliding.size() / (double) total;
+
+  std::stringstream str;
+  std::cout << "FAIL "<<failCnt << ": Minimum agreement not reached. "
+            << "Agreement: "<<positive<<", "<<negative<<std::endl;
 
-    ASSERT_EQ(numWorlds, total) << "All worlds must have voted";
-    ASSERT_GT(total, 0 ) << "This should have been caught before";
+  // str << " Collision: "<< VectorToString(colliding) << ", no collision: "
+  //     << VectorToString(notColliding) << ".";
 
-    double negative = notColliding.size() / (double) total;
-    double positive= colliding.size() / (double) total;
+  str << "------ " << std::endl;
+  str << "Colliding: " << std::endl
+      << "------ " << std::endl;
+  for (std::vector<std::string>::const_iterator it = colliding.begin();
+       it != colliding.end(); ++it)
+  {
+    if (it != colliding.begin()) str << std::endl;
+    std::vector<GzContactInfoPtr> contacts =
+      collision_benchmark::GetContactInfo(modelName1, modelName2,
+                                          *it, worldManager);
+    str << *it << ": " << VectorPtrToString(contacts);
+  }
 
-    if (((positive > negative) && (positive < minAgree)) ||
-        ((positive <= negative) && (negative < minAgree)))
+  str << std::endl;
+  str << "------ " << std::endl;
+  str << "Not colliding: " << std::endl
+      << "------ " << std::endl;
+  for (std::vector<std::string>::const_iterator it = notColliding.begin();
+       it != notColliding.end(); ++it)
+  {
+    if (it != notColliding.begin()) str << std::endl;
+    std::vector<GzContactInfoPtr> contacts =
+      collision_benchmark::GetContactInfo(modelName1, modelName2,
+                                          *it, worldManager);
+    str << *it << ": " << VectorPtrToString(contacts);
+  }
+  str << std::endl;
+
+  if (!outputBasePath.empty() &&
+      collision_benchmark::makeDirectoryIfNeeded(outputBasePath+
+                                                 "/"+outputSubdir))
+  {
+    if (!disagreementLog)
     {
-      std::stringstream str;
-      std::cout << "FAIL "<<failCnt << ": Minimum agreement not reached. "
-                << "Agreement: "<<positive<<", "<<negative<<std::endl;
-
-      // str << " Collision: "<< VectorToString(colliding) << ", no collision: "
-      //     << VectorToString(notColliding) << ".";
-
-      str << "------ " << std::endl;
-      str << "Colliding: " << std::endl
-          << "------ " << std::endl;
-      for (std::vector<std::string>::iterator it = colliding.begin();
-           it != colliding.end(); ++it)
+      // the worlds are only saved once, as the scene of the log. For each
+      // failure, only the state of model 2 and a summary of the contacts
+      // is logged. The world files of a failure can be created from the
+      // log with disagreement_log_tool.
+      const std::string scenePrefix = "STest_scene";
+      int nFails = worldManager->SaveAllWorlds(outputBasePath,
+                                               outputSubdir,
+                                               scenePrefix,
+                                               "world", true);
+      std::vector<std::string> sceneFiles;
+      GzWorldManager::WorldsSnapshotConstPtr snapshot =
+        worldManager->GetWorldsSnapshot();
+      for (std::vector<PhysicsWorldBaseInterface::Ptr>::const_iterator
+           it = snapshot->worlds.begin(); it != snapshot->worlds.end(); ++it)
       {
-        if (it != colliding.begin()) str << std::endl;
-        std::vector<GzContactInfoPtr> contacts =
-          collision_benchmark::GetContactInfo(modelName1, modelName2,
-                                              *it, worldManager);
-        str << *it << ": " << VectorPtrToString(contacts);
+        sceneFiles.push_back(scenePrefix + "_" + (*it)->GetName() + ".world");
       }
-
-      str << std::endl;
-      str << "------ " << std::endl;
-      str << "Not colliding: " << std::endl
-          << "------ " << std::endl;
-      for (std::vector<std::string>::iterator it = notColliding.begin();
-           it != notColliding.end(); ++it)
+      const std::string logFile =
+        outputBasePath + "/" + outputSubdir + "/STest_disagreements.log";
+      disagreementLog.reset(new collision_benchmark::DisagreementLogWriter());
+      if (!disagreementLog->Open(logFile, modelName1, modelName2,
+                                 sceneFiles, resumeFromCheckpoint))
+      {
+        std::cerr << "Could not open log " << logFile << std::endl;
+      }
+      std::cout << "Scene written to " << outputBasePath
+                << "/" << outputSubdir
+                << " (failed: "<< nFails << "), logging to "
+                << logFile << std::endl;
+    }
+    if (disagreementLog->IsOpen())
+    {
+      std::vector<collision_benchmark::DisagreementWorldSummary>
+        summaries(worldManager->GetNumWorlds());
+      GzWorldManager::WorldsSnapshotConstPtr snapshot =
+        worldManager->GetWorldsSnapshot();
+      for (unsigned int w = 0; w < snapshot->worlds.size() &&
+           w < summaries.size(); ++w)
       {
-        if (it != notColliding.begin()) str << std::endl;
         std::vector<GzContactInfoPtr> contacts =
           collision_benchmark::GetContactInfo(modelName1, modelName2,
-                                              *it, worldManager);
-        str << *it << ": " << VectorPtrToString(contacts);
+                                              snapshot->worlds[w]->GetName(),
+                                              worldManager);
+        collision_benchmark::DisagreementWorldSummary& summary =
+          summaries[w];
+        summary.colliding = contacts.empty() ? 0 : 1;
+        summary.numContacts = 0;
+        summary.maxDepth = 0;
+        for (std::vector<GzContactInfoPtr>::const_iterator
+             it = contacts.begin(); it != contacts.end(); ++it)
+        {
+          summary.numContacts += (*it)->contacts.size();
+          for (unsigned int c = 0; c < (*it)->contacts.size(); ++c)
+          {
+            if ((*it)->contacts[c].depth > summary.maxDepth)
+              summary.maxDepth = (*it)->contacts[c].depth;
+          }
+        }
       }
-      str << std::endl;
-
-      if (!outputBasePath.empty() &&
-          collision_benchmark::makeDirectoryIfNeeded(outputBasePath+
-                                                     "/"+outputSubdir))
+      if (!disagreementLog->Write(collision_benchmark::DisagreementLogWriter::
+                                  CreateRecord(failCnt, cell, state),
+                                  summaries))
       {
-        std::stringstream namePrefix;
-        namePrefix << "STest_fail_" << failCnt << "_";
-        int nFails = worldManager->SaveAllWorlds(outputBasePath,
-                                                 outputSubdir,
-                                                 namePrefix.str(),
-                                                 "world", true);
-        std::cout << "Worlds written to " << outputBasePath
-                  << "/" << outputSubdir
-                  << " (failed: "<< nFails << ")" <<std::endl;
+        std::cerr << "Could not write failure " << failCnt
+                  << " to the log" << std::endl;
       }
+    }
+  }
 
-      if (interactive)
+  if (interactive)
+  {
+    std::cout << str.str() << std::endl
+              << "Press [Enter] to continue."<<std::endl;
+    RefreshClient(5);
+    collision_benchmark::UpdateUntilEnter(worldManager);
+  }
+  else
+  {
+    // trigger a test failure
+    EXPECT_TRUE(false) << str.str();
+  }
+}
+
+////////////////////////////////////////////////////////////////
+void StaticTestFramework::AdaptiveAABBTestWorldsAgreement
+                                  (const std::string& modelName1,
+                                   const std::string& modelName2,
+                                   const float initialCellSizeFactor,
+                                   const float minCellSizeFactor,
+                                   const unsigned int maxSamples,
+                                   const double minAgree,
+                                   const double bbTol,
+                                   const double zeroDepthTol,
+                                   const bool interactive,
+                                   const std::string& outputBasePath,
+                                   const std::string& outputSubdir)
+{
+  ASSERT_GT(minCellSizeFactor, 1e-07) << "Minimum cell size factor too small";
+  ASSERT_GE(initialCellSizeFactor, minCellSizeFactor)
+    << "Initial cell size must not be smaller than the minimum cell size";
+
+  GzWorldManager::Ptr worldManager;
+  collision_benchmark::GzAABB grid;
+  ASSERT_NO_FATAL_FAILURE(PrepareSweep(modelName1, modelName2, bbTol, false,
+                                       interactive, worldManager, grid));
+
+  // The samples are taken at the points of a lattice which has the
+  // resolution of the finest level. The coarsest level has
+  // numCoarse cells along each axis, and each level halves the cell size.
+  double eps = 1e-06;
+  unsigned int numCoarse =
+    std::max(1, static_cast<int>(ceil(1.0 / initialCellSizeFactor - eps)));
+  unsigned int numLevels = 0;
+  while ((numCoarse << numLevels) * minCellSizeFactor < 1 - eps)
+    ++numLevels;
+  ASSERT_LE(numLevels, 16u) << "Minimum cell size too small";
+  // number of cells along each axis at the finest level
+  const uint64_t numFine = numCoarse << numLevels;
+
+  std::cout << "Now starting adaptive sweep with " << numCoarse
+            << " initial cells and " << numLevels << " levels of "
+            << "refinement per axis." << std::endl;
+
+  // result of a sample at a lattice point
+  struct Sample
+  {
+    // whether the majority of the engines found a collision
+    bool colliding;
+    // whether the engines reached the minimum agreement
+    bool agree;
+  };
+  // all samples taken so far, by the index of their lattice point.
+  // Corners are shared between neighbouring cells and between levels,
+  // so each lattice point is only sampled once.
+  std::unordered_map<uint64_t, Sample> samples;
+
+  // a cell of the lattice with its minimum corner at lattice point (x,y,z)
+  struct Cell
+  {
+    uint64_t x, y, z;
+    unsigned int level;
+  };
+  // cells are refined breadth first, so that the sample budget is spent
+  // on the coarser levels first.
+  std::deque<Cell> cells;
+  const uint64_t coarseSize = 1u << numLevels;
+  for (uint64_t x = 0; x < numCoarse; ++x)
+  for (uint64_t y = 0; y < numCoarse; ++y)
+  for (uint64_t z = 0; z < numCoarse; ++z)
+  {
+    Cell c = {x * coarseSize, y * coarseSize, z * coarseSize, 0};
+    cells.push_back(c);
+  }
+
+  disagreementLog.reset();
+  unsigned int failCnt = 0;
+  unsigned int numRefined = 0;
+  bool budgetReached = false;
+  while (!cells.empty() && !budgetReached)
+  {
+    Cell cell = cells.front();
+    cells.pop_front();
+    const uint64_t size = 1u << (numLevels - cell.level);
+
+    bool refine = false;
+    bool firstColliding = false;
+    for (unsigned int corner = 0; corner < 8; ++corner)
+    {
+      uint64_t x = cell.x + ((corner & 1) ? size : 0);
+      uint64_t y = cell.y + ((corner & 2) ? size : 0);
+      uint64_t z = cell.z + ((corner & 4) ? size : 0);
+      uint64_t key = (x * (numFine + 1) + y) * (numFine + 1) + z;
+
+      std::unordered_map<uint64_t, Sample>::const_iterator it =
+        samples.find(key);
+      Sample sample;
+      if (it != samples.end())
       {
-        std::cout << str.str() << std::endl
-                  << "Press [Enter] to continue."<<std::endl;
-        RefreshClient(5);
-        collision_benchmark::UpdateUntilEnter(worldManager);
+        sample = it->second;
       }
       else
       {
-        // trigger a test failure
-        EXPECT_TRUE(false) << str.str();
+        if (samples.size() >= maxSamples)
+        {
+          budgetReached = true;
+          break;
+        }
+        Vector3 position(grid.min.X() + grid.size().X() * x / numFine,
+                         grid.min.Y() + grid.size().Y() * y / numFine,
+                         grid.min.Z() + grid.size().Z() * z / numFine);
+        BasicState state;
+        state.SetPosition(position);
+        std::vector<std::string> colliding, notColliding;
+        double maxContactDepth;
+        ASSERT_TRUE(EvaluateCell(worldManager, modelName1, modelName2,
+                                 state, minAgree, zeroDepthTol, sample.agree,
+                                 colliding, notColliding, maxContactDepth))
+          << "Could not evaluate position " << position;
+        // if the worlds agree, not all worlds may have been queried,
+        // but the majority is known.
+        sample.colliding = colliding.size() > notColliding.size();
+        samples[key] = sample;
+        if (!sample.agree)
+        {
+          ReportDisagreement(worldManager, modelName1, modelName2,
+                             colliding, notColliding, state, key, failCnt,
+                             interactive, outputBasePath, outputSubdir);
+          ++failCnt;
+        }
+      }
+      // refine cells where the engines disagree or which
+      // contain the boundary between collision and no collision
+      if (!sample.agree) refine = true;
+      if (corner == 0) firstColliding = sample.colliding;
+      else if (sample.colliding != firstColliding) refine = true;
+    }
+
+    if (refine && !budgetReached && (cell.level < numLevels))
+    {
+      ++numRefined;
+      const uint64_t half = size / 2;
+      for (unsigned int child = 0; child < 8; ++child)
+      {
+        Cell c = {cell.x + ((child & 1) ? half : 0),
+                  cell.y + ((child & 2) ? half : 0),
+                  cell.z + ((child & 4) ? half : 0),
+                  cell.level + 1};
+        cells.push_back(c);
       }
-      ++failCnt;
     }
   }
-  std::cout<<"TwoModels test finished. "<<std::endl;
+
+  if (budgetReached)
+  {
+    std::cout << "Sample budget of " << maxSamples << " reached, "
+              << cells.size() + 1 << " cells were not evaluated."
+              << std::endl;
+  }
+  std::cout << "Adaptive sweep finished with " << samples.size()
+            << " samples (uniform sweep at the minimum cell size: "
+            << (numFine + 1) * (numFine + 1) * (numFine + 1) << "), "
+            << numRefined << " cells refined, " << failCnt
+            << " disagreements." << std::endl;
 }
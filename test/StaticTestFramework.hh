@@ -20,8 +20,13 @@
 #include <test/MultipleWorldsTestFramework.hh>
 #include <test/TestUtils.hh>
 #include <collision_benchmark/Shape.hh>
+#include <collision_benchmark/BasicTypes.hh>
+#include <collision_benchmark/DisagreementLog.hh>
 
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 class StaticTestFramework : public MultipleWorldsTestFramework {
@@ -31,7 +36,9 @@ protected:
   typedef GzContactInfo::Ptr GzContactInfoPtr;
 
   StaticTestFramework():
-    MultipleWorldsTestFramework()
+    MultipleWorldsTestFramework(),
+    resumeFromCheckpoint(false),
+    checkpointBlockSize(1000)
   {}
   virtual ~StaticTestFramework()
   {}
@@ -92,6 +99,21 @@ protected:
                  const std::string& modelName,
                  const unsigned int worldIdx);
 
+  // \brief Enables checkpoints of the progress of the sweeps in
+  // AABBTestWorldsAgreement() and AABBOrientationTestWorldsAgreement().
+  // The progress is written to a file in \e checkpointDir, named after
+  // the current test, each time \e blockSize more cells have been
+  // evaluated. The file is removed once the sweep is complete.
+  // \param[in] checkpointDir writable directory for the checkpoint files.
+  //    If empty, no checkpoints are written.
+  // \param[in] resume if true, sweeps continue from the last checkpoint
+  //    of the test if there is one. Disagreements found before the
+  //    checkpoint are reported as one test failure.
+  // \param[in] blockSize number of cells between two checkpoints
+  void SetCheckpoint(const std::string& checkpointDir,
+                     const bool resume,
+                     const unsigned int blockSize = 1000);
+
   // Two models, which must already have been loaded, are moved relative to
   // each other by iterating through states in which their AABBs intersect.
   // Alll engines have to agree on the collision state (boolean collision).
@@ -130,6 +152,15 @@ protected:
   // \param outputSubdir subdirectory of \e outputBasePath where the result
   //    files will be written to. Resource references use this relative path.
   //    If \e outputBasePath is emtpy, this parameter will have no effect.
+  // \param numShards number of independent copies of all worlds to
+  //    run the test with. The grid cells are split into contiguous blocks
+  //    for the copies, and each copy is run in its own thread.
+  //    Disagreements are reported in the order of the grid cells,
+  //    as with only one shard. Only worlds
+  //    and models loaded with the loading functions of this class can be
+  //    copied. If this is not the case, or if \e interactive is true, only
+  //    one shard is used. The copies are kept for the following tests
+  //    of the same fixture.
   void AABBTestWorldsAgreement(const std::string& modelName1,
                 const std::string& modelName2,
                 const float cellSizeFactor = 0.1,
@@ -138,10 +169,264 @@ protected:
                 const double zeroDepthTol = 5e-02,
                 const bool interactive = false,
                 const std::string& outputBasePath = "",
+                const std::string& outputSubdir = "",
+                const unsigned int numShards = 1);
+
+  // Like AABBTestWorldsAgreement(), but model 2 is also rotated: at each
+  // position of the grid, all orientations of a uniform grid on SO(3)
+  // (see collision_benchmark::GetHopfOrientations()) are tested.
+  // Because model 2 can have any orientation, the grid is formed by the
+  // AABB of model 1, expanded by the radius of the sphere around the
+  // AABB of model 2.
+  //
+  // Consecutive states of model 2 are close to each other, so that
+  // the engines can re-use information of the previous state.
+  //
+  // Throws gtest assertions so needs to be called from top-level
+  // test function (nested function calls will not work correctly)
+  //
+  // \param[in] orientationResolution resolution of the grid on SO(3).
+  //    Level 0 has 72 orientations, and each level has 8 times as many
+  //    orientations as the previous one.
+  // For all other parameters, see AABBTestWorldsAgreement().
+  void AABBOrientationTestWorldsAgreement(const std::string& modelName1,
+                const std::string& modelName2,
+                const float cellSizeFactor = 0.2,
+                const unsigned int orientationResolution = 0,
+                const double minAgree = 0.999,
+                const double bbTol = 5e-02,
+                const double zeroDepthTol = 5e-02,
+                const bool interactive = false,
+                const std::string& outputBasePath = "",
+                const std::string& outputSubdir = "",
+                const unsigned int numShards = 1);
+
+  // Like AABBTestWorldsAgreement(), but instead of a uniform grid, model 2
+  // is moved through an adaptively refined grid: the sweep starts with
+  // coarse cells, and only cells whose corners differ in the collision
+  // state, or where the engines disagree, are split into eight
+  // smaller cells. The state at each corner is only sampled once.
+  // This concentrates the samples at the boundary of the collision,
+  // where disagreements between the engines are most likely.
+  //
+  // Throws gtest assertions so needs to be called from top-level
+  // test function (nested function calls will not work correctly)
+  //
+  // \param[in] initialCellSizeFactor the proportion of the 3D grid
+  //    that will be used as the size of the initial cells.
+  // \param[in] minCellSizeFactor the proportion of the 3D grid below
+  //    which cells are not refined any further.
+  // \param[in] maxSamples maximum number of samples (updates of the
+  //    worlds) to take. The sweep stops when this budget is used up.
+  // \param[in] minAgree see AABBTestWorldsAgreement()
+  // \param[in] bbTol see AABBTestWorldsAgreement()
+  // \param[in] zeroDepthTol see AABBTestWorldsAgreement()
+  // \param[in] interactive see AABBTestWorldsAgreement()
+  // \param[in] outputBasePath see AABBTestWorldsAgreement()
+  // \param outputSubdir see AABBTestWorldsAgreement()
+  void AdaptiveAABBTestWorldsAgreement(const std::string& modelName1,
+                const std::string& modelName2,
+                const float initialCellSizeFactor = 0.25,
+                const float minCellSizeFactor = 0.01,
+                const unsigned int maxSamples = 20000,
+                const double minAgree = 0.999,
+                const double bbTol = 5e-02,
+                const double zeroDepthTol = 5e-02,
+                const bool interactive = false,
+                const std::string& outputBasePath = "",
                 const std::string& outputSubdir = "");
 
 private:
 
+  // Engine, name and models of a world which was loaded with the
+  // loading functions of this class, so that the world can be re-created.
+  struct WorldSetup
+  {
+    std::string engine;
+    std::string worldname;
+    // name and shape of all models loaded into the world
+    std::vector<std::pair<std::string,
+                          collision_benchmark::Shape::Ptr> > shapes;
+  };
+
+  // Result of the evaluation of one grid cell by a shard
+  struct CellResult
+  {
+    CellResult(): evaluated(false), agree(true) {}
+    // false if the cell could not be evaluated
+    bool evaluated;
+    // whether the minimum agreement was reached
+    bool agree;
+  };
+
+  // Copies of all worlds which are used as one shard
+  struct Shard
+  {
+    GzWorldManager::Ptr worldManager;
+    // the worlds and models which were copied into the shard so far,
+    // at the same index as the worlds in worldSetups
+    std::vector<WorldSetup> setups;
+  };
+
+  // Returns the world manager of the server and \e numShards - 1 world
+  // managers with copies of all worlds, as described by \e worldSetups,
+  // in \e shards. The copies are created on the first call and kept in
+  // shardCache, so that following sweeps re-use them.
+  // \return false if the worlds could not be copied
+  bool CreateShards(const unsigned int numShards,
+                    std::vector<GzWorldManager::Ptr>& shards);
+
+  // Loads the worlds and models of \e worldSetups which are not
+  // in shard number \e k yet into \e shard.
+  // \return false if the worlds could not be copied
+  bool UpdateShard(const unsigned int k, Shard& shard);
+
+  // Sets model 2 to \e state in all worlds of \e worldManager,
+  // updates the worlds and determines whether the engines agree about the
+  // collision state of the models as in
+  // collision_benchmark::CollisionAgreement().
+  // \return false if the model could not be placed in all worlds or the
+  //    collision state could not be determined.
+  static bool EvaluateCell(const GzWorldManager::Ptr& worldManager,
+                           const std::string& modelName1,
+                           const std::string& modelName2,
+                           const collision_benchmark::BasicState& state,
+                           const double minAgree,
+                           const double zeroDepthTol,
+                           bool& agree,
+                           std::vector<std::string>& colliding,
+                           std::vector<std::string>& notColliding,
+                           double& maxContactDepth);
+
+  // Evaluates the cells at index [\e first, \e end)
+  // in \e cells with \e worldManager and writes the result of each cell
+  // into \e results, which has to be of the same size as \e cells.
+  // Stops when \e abort is set, and sets it if a cell cannot be evaluated.
+  static void EvaluateCells(const GzWorldManager::Ptr& worldManager,
+                    const std::string& modelName1,
+                    const std::string& modelName2,
+                    const std::vector<collision_benchmark::BasicState>& cells,
+                    const unsigned int first,
+                    const unsigned int end,
+                    const double minAgree,
+                    const double zeroDepthTol,
+                    std::vector<CellResult>& results,
+                    std::atomic<bool>& abort);
+
+  // Prepares a sweep of model 2 around model 1, shared by all sweeps:
+  // disables the dynamics of the worlds of the server and returns its
+  // world manager in \e worldManager, and the region in which model 2 is
+  // placed in \e grid. This is the AABB of model 1, extended by half the
+  // size of the AABB of model 2, or by the radius of the sphere around it
+  // if \e anyOrientation is true. If \e interactive is true, waits for the
+  // user to start gzclient.
+  // Uses gtest assertions, so call it with ASSERT_NO_FATAL_FAILURE().
+  // See AABBTestWorldsAgreement() for the other parameters.
+  void PrepareSweep(const std::string& modelName1,
+                    const std::string& modelName2,
+                    const double bbTol,
+                    const bool anyOrientation,
+                    const bool interactive,
+                    GzWorldManager::Ptr& worldManager,
+                    collision_benchmark::GzAABB& grid);
+
+  // Evaluates all states of model 2 in \e cells, in the given order,
+  // and reports all cells in which the engines don't reach the minimum
+  // agreement. \e worldManager is the one returned by PrepareSweep().
+  // See AABBTestWorldsAgreement() for the other parameters.
+  void SweepWorldsAgreement(const GzWorldManager::Ptr& worldManager,
+                    const std::string& modelName1,
+                    const std::string& modelName2,
+                    const std::vector<collision_benchmark::BasicState>& cells,
+                    const double minAgree,
+                    const double zeroDepthTol,
+                    const bool interactive,
+                    const std::string& outputBasePath,
+                    const std::string& outputSubdir,
+                    const unsigned int numShards);
+
+  // Prints the collision state of the worlds in \e worldManager which
+  // failed to reach the minimum agreement and triggers a test failure,
+  // or waits for the user if \e interactive is true.
+  // If \e outputBasePath is not empty, the failure is written to the
+  // log of disagreements of the current sweep: at the first failure, the
+  // worlds are saved as the scene of the log, and for each failure
+  // \e state of model 2 and a summary of the contacts are logged.
+  // See also AABBTestWorldsAgreement() and
+  // collision_benchmark::DisagreementLogWriter.
+  // \param[in] state the state of model 2
+  // \param[in] cell index of the cell in the sweep
+  void ReportDisagreement(const GzWorldManager::Ptr& worldManager,
+                          const std::string& modelName1,
+                          const std::string& modelName2,
+                          const std::vector<std::string>& colliding,
+                          const std::vector<std::string>& notColliding,
+                          const collision_benchmark::BasicState& state,
+                          const uint64_t cell,
+                          const unsigned int failCnt,
+                          const bool interactive,
+                          const std::string& outputBasePath,
+                          const std::string& outputSubdir);
+
+  // \return the name of the checkpoint file of the current test,
+  //    or an empty string if no checkpoints are written.
+  std::string GetCheckpointFile() const;
+
+  // \return a hash of the parameters of a sweep over \e cells: the world
+  // file, engines and models of all worlds (see worldSetups), the names
+  // of the two models, all states of model 2 (which depend on the cell
+  // size, the grid bounds and the sizes of the shapes) and the
+  // tolerances. It is stored in the checkpoints, so that a sweep is only
+  // resumed with the same parameters.
+  uint64_t GetSweepHash(const std::string& modelName1,
+                    const std::string& modelName2,
+                    const std::vector<collision_benchmark::BasicState>& cells,
+                    const double minAgree,
+                    const double zeroDepthTol) const;
+
+  // Writes the progress of a sweep over \e numCells cells with
+  // \e numWorlds worlds to \e filename: the index of the next cell to
+  // evaluate and the indices of all cells in which the worlds disagreed.
+  // The worlds do not need to be saved, because each cell sets the
+  // state of the moving model in all worlds.
+  // \param sweepHash hash of the sweep parameters, see GetSweepHash()
+  // \return false if the file could not be written
+  static bool WriteCheckpoint(const std::string& filename,
+                              const uint64_t sweepHash,
+                              const unsigned int numCells,
+                              const unsigned int numWorlds,
+                              const unsigned int nextCell,
+                              const std::vector<unsigned int>& failedCells);
+
+  // Reads a checkpoint written with WriteCheckpoint().
+  // \return false if the file does not exist, is invalid or was written
+  //    for a sweep with a different hash, number of cells or worlds.
+  static bool ReadCheckpoint(const std::string& filename,
+                             const uint64_t sweepHash,
+                             const unsigned int numCells,
+                             const unsigned int numWorlds,
+                             unsigned int& nextCell,
+                             std::vector<unsigned int>& failedCells);
+
+  // log of the disagreements of the current sweep,
+  // opened in ReportDisagreement()
+  collision_benchmark::DisagreementLogWriter::Ptr disagreementLog;
+
+  // directory for checkpoints, see SetCheckpoint()
+  std::string checkpointPath;
+  // whether to resume from existing checkpoints, see SetCheckpoint()
+  bool resumeFromCheckpoint;
+  // number of cells between two checkpoints, see SetCheckpoint()
+  unsigned int checkpointBlockSize;
+
+  // all worlds loaded with the loading functions of this class,
+  // in the order they were added to the world manager
+  std::vector<WorldSetup> worldSetups;
+
+  // the shards created by CreateShards(), without the first shard
+  // (the world manager of the server)
+  std::vector<Shard> shardCache;
+
   // checks that AABB of model 1 and 2 are the same in all worlds and
   // returns the two AABBs
   // \param bbTol tolerance for comparison of bounding box sizes. The min/max
@@ -2,6 +2,7 @@
 #include <collision_benchmark/PrimitiveShape.hh>
 #include <collision_benchmark/SimpleTriMeshShape.hh>
 #include <collision_benchmark/BasicTypes.hh>
+#include <collision_benchmark/Trace.hh>
 
 #include <collision_benchmark/MeshShapeGeneratorVtk.hh>
 
@@ -10,6 +11,9 @@
 
 #include "StaticTestFramework.hh"
 
+#include <algorithm>
+#include <cstdlib>
+
 using collision_benchmark::Shape;
 using collision_benchmark::PrimitiveShape;
 using collision_benchmark::SimpleTriMeshShape;
@@ -32,12 +36,38 @@ bool defaultInteractive = false;
 // Default output path (empty string prevents writing to file)
 std::string defaultOutputPath = "";
 
+// Default number of shards (copies of the worlds run in parallel)
+unsigned int defaultNumShards = 1;
+
+// Default directory for checkpoints of the sweeps
+// (empty string prevents writing checkpoints)
+std::string defaultCheckpointPath = "";
+
+// Default value to resume sweeps from their last checkpoint
+bool defaultResume = false;
+
+// File to write the trace of the tests to
+// (empty string disables tracing)
+std::string traceFile = "";
+
 class StaticTest:
-  public StaticTestFramework {};
+  public StaticTestFramework
+{
+  protected: StaticTest()
+  {
+    SetCheckpoint(defaultCheckpointPath, defaultResume);
+  }
+};
 
 class StaticTestWithParam:
   public StaticTestFramework,
-  public testing::WithParamInterface<const char*> {};
+  public testing::WithParamInterface<const char*>
+{
+  protected: StaticTestWithParam()
+  {
+    SetCheckpoint(defaultCheckpointPath, defaultResume);
+  }
+};
 
 //////////////////////////////////////////////////////////////////////////////
 // Helper to create a simple shape out of two triangles
@@ -90,7 +120,67 @@ TEST_F(StaticTest, BoxCylinderTest)
   const static float cellSizeFactor = 0.1;
   AABBTestWorldsAgreement(modelName1, modelName2, cellSizeFactor, minAgree,
            bbTol, zeroDepthTol, interactive,
-           defaultOutputPath, "BoxCylinderTest");
+           defaultOutputPath, "BoxCylinderTest", defaultNumShards);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// AABBOrientationTestWorldsAgreement with one cylinder primitive
+// and one box primitive
+TEST_F(StaticTest, BoxCylinderOrientationTest)
+{
+  std::vector<std::string> selectedEngines;
+  selectedEngines.push_back("bullet");
+  selectedEngines.push_back("ode");
+  selectedEngines.push_back("dart");
+
+  // Model 1
+  std::string modelName1 = "model1";
+  Shape::Ptr shape1(PrimitiveShape::CreateBox(2,2,2));
+  // Model 2
+  std::string modelName2 = "model2";
+  Shape::Ptr shape2(PrimitiveShape::CreateCylinder(1,3));
+
+  InitMultipleEngines(selectedEngines);
+  LoadShape(shape1, modelName1);
+  LoadShape(shape2, modelName2);
+  const static bool interactive = defaultInteractive;
+  const static float cellSizeFactor = 0.25;
+  const static unsigned int orientationResolution = 0;
+  AABBOrientationTestWorldsAgreement(modelName1, modelName2, cellSizeFactor,
+           orientationResolution, minAgree, bbTol, zeroDepthTol, interactive,
+           defaultOutputPath, "BoxCylinderOrientationTest",
+           defaultNumShards);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// AdaptiveAABBTestWorldsAgreement with one cylinder primitive
+// and one box primitive
+TEST_F(StaticTest, BoxCylinderAdaptiveTest)
+{
+  std::vector<std::string> selectedEngines;
+  selectedEngines.push_back("bullet");
+  selectedEngines.push_back("ode");
+  selectedEngines.push_back("dart");
+
+  // Model 1
+  std::string modelName1 = "model1";
+  Shape::Ptr shape1(PrimitiveShape::CreateBox(2,2,2));
+  // Model 2
+  std::string modelName2 = "model2";
+  Shape::Ptr shape2(PrimitiveShape::CreateCylinder(1,3));
+
+  InitMultipleEngines(selectedEngines);
+  LoadShape(shape1, modelName1);
+  LoadShape(shape2, modelName2);
+  const static bool interactive = defaultInteractive;
+  const static float initialCellSizeFactor = 0.25;
+  const static float minCellSizeFactor = 0.02;
+  const static unsigned int maxSamples = 10000;
+  AdaptiveAABBTestWorldsAgreement(modelName1, modelName2,
+                                  initialCellSizeFactor, minCellSizeFactor,
+                                  maxSamples, minAgree, bbTol, zeroDepthTol,
+                                  interactive, defaultOutputPath,
+                                  "BoxCylinderAdaptiveTest");
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -125,7 +215,8 @@ TEST_F(StaticTest, CylinderAndTwoTriangles)
   const static float cellSizeFactor = 0.1;
   AABBTestWorldsAgreement(modelName1, modelName2, cellSizeFactor, minAgree,
                           bbTol, zeroDepthTol, interactive,
-                          defaultOutputPath, "CylinderAndTwoTriangles");
+                          defaultOutputPath, "CylinderAndTwoTriangles",
+                          defaultNumShards);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -168,7 +259,8 @@ TEST_F(StaticTest, SpherePrimMesh)
   const static float cellSizeFactor = 0.1;
   AABBTestWorldsAgreement(meshName, primName, cellSizeFactor, minAgree,
                           bbTol, zeroDepthTol, interactive,
-                          defaultOutputPath, "SpherePrimMesh");
+                          defaultOutputPath, "SpherePrimMesh",
+                          defaultNumShards);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -210,7 +302,8 @@ TEST_P(StaticTestWithParam, SphereEquivalentsTest)
   const double _bbTol = 0.15;
   AABBTestWorldsAgreement(modelName1, modelName2, cellSizeFactor, minAgree,
                           _bbTol, zeroDepthTol, interactive,
-                          defaultOutputPath, "SphereEquivalentTest");
+                          defaultOutputPath, "SphereEquivalentTest",
+                          defaultNumShards);
 }
 
 // cannot test simbody because there are still issues with meshes and
@@ -240,11 +333,60 @@ int main(int argc, char**argv)
       defaultOutputPath = argv[i];
       std::cout << "Writing files to " << defaultOutputPath << std::endl;
     }
+    else if (strcmp(argv[i], "--shards") == 0)
+    {
+      if (i+1 >= argc)
+      {
+        std::cerr << "--shards requires specification of a number"
+                  << std::endl;
+        continue;
+      }
+      ++i;
+      defaultNumShards = std::max(1, atoi(argv[i]));
+      std::cout << "Running with " << defaultNumShards << " shards"
+                << std::endl;
+    }
+    else if (strcmp(argv[i], "--checkpoint") == 0)
+    {
+      if (i+1 >= argc)
+      {
+        std::cerr << "--checkpoint requires specification of a path"
+                  << std::endl;
+        continue;
+      }
+      ++i;
+      defaultCheckpointPath = argv[i];
+      std::cout << "Writing checkpoints to " << defaultCheckpointPath
+                << std::endl;
+    }
+    else if (strcmp(argv[i], "--resume") == 0)
+    {
+      defaultResume = true;
+    }
+    else if (strcmp(argv[i], "--trace") == 0)
+    {
+      if (i+1 >= argc)
+      {
+        std::cerr << "--trace requires specification of a file"
+                  << std::endl;
+        continue;
+      }
+      ++i;
+      traceFile = argv[i];
+      std::cout << "Writing trace to " << traceFile << std::endl;
+    }
     else
     {
       std::cerr << "Unrecognized command line parameter: "
                 << argv[i] << std::endl;
     }
   }
-  return RUN_ALL_TESTS();
+  if (!traceFile.empty()) collision_benchmark::Trace::Enable();
+  int ret = RUN_ALL_TESTS();
+  if (!traceFile.empty())
+  {
+    collision_benchmark::Trace::Disable();
+    collision_benchmark::Trace::WriteChromeJSON(traceFile);
+  }
+  return ret;
 }
@@ -9,6 +9,7 @@
 
 #include <boost/filesystem.hpp>
 
+#include <cmath>
 #include <sstream>
 #include <thread>
 #include <atomic>
@@ -50,17 +51,26 @@ bool collision_benchmark::GetConsistentAABB(const std::string& modelName,
                                   const double bbTol,
                                   GzAABB& mAABB)
 {
-  std::vector<GzWorldManager::PhysicsWorldModelInterfacePtr>
-    worlds = worldManager->GetModelPhysicsWorlds();
+  // use the snapshot of the worlds to avoid copying the vector of worlds
+  GzWorldManager::WorldsSnapshotConstPtr snapshot =
+    worldManager->GetWorldsSnapshot();
+  const std::vector<GzWorldManager::PhysicsWorldModelInterfacePtr>&
+    worlds = snapshot->modelWorlds;
 
   // AABB's from all worlds: need to be equal or this function
   // must return false.
   std::vector<GzAABB> aabbs;
 
-  std::vector<GzWorldManager::PhysicsWorldModelInterfacePtr>::iterator it;
+  std::vector<GzWorldManager::PhysicsWorldModelInterfacePtr>::const_iterator it;
   for (it = worlds.begin(); it != worlds.end(); ++it)
   {
-    GzWorldManager::PhysicsWorldModelInterfacePtr w = *it;
+    const GzWorldManager::PhysicsWorldModelInterfacePtr& w = *it;
+    if (!w)
+    {
+      std::cerr << "A world does not support the model interface"
+                << std::endl;
+      return false;
+    }
     GzAABB aabb;
     if (!w->GetAABB(modelName, aabb.min, aabb.max))
     {
@@ -135,33 +145,32 @@ bool collision_benchmark::CollisionState(const std::string& modelName1,
   maxDepth = 0;
   if (!worldManager) return false;
 
-  std::vector<GzWorldManager::PhysicsWorldPtr>
-    worlds = worldManager->GetPhysicsWorlds();
+  // use the snapshot of the worlds to avoid copying the vector of worlds
+  GzWorldManager::WorldsSnapshotConstPtr snapshot =
+    worldManager->GetWorldsSnapshot();
+  const std::vector<GzWorldManager::PhysicsWorldPtr>&
+    worlds = snapshot->physicsWorlds;
 
-  std::vector<GzWorldManager::PhysicsWorldPtr>::iterator it;
+  std::vector<GzWorldManager::PhysicsWorldPtr>::const_iterator it;
   for (it = worlds.begin(); it != worlds.end(); ++it)
   {
-    GzWorldManager::PhysicsWorldPtr w = *it;
-    if (!w->SupportsContacts())
+    const GzWorldManager::PhysicsWorldPtr& w = *it;
+    if (!w || !w->SupportsContacts())
     {
       std::cout<<"A world does not support contact calculation"<<std::endl;
       return false;
     }
 
-    std::vector<GzContactInfoPtr> contacts =
-      w->GetContactInfo(modelName1, modelName2);
-    if (!contacts.empty())
+    // this is called for each step of a test, so re-use the
+    // buffer to avoid allocating memory for the contacts each time.
+    static thread_local GzContactBuffer contacts;
+    w->FillContactBuffer(modelName1, modelName2, contacts);
+    if (contacts.GetNumPairs() > 0)
     {
       colliding.push_back(w->GetName());
-      for (typename std::vector<GzContactInfoPtr>::const_iterator
-           cit = contacts.begin(); cit != contacts.end(); ++cit)
-      {
-        GzContactInfoPtr c = *cit;
-        // std::cout << "World " << w->GetName() <<" Contact: " << *c << std::endl;
-        double tmpMax;
-        if (c->maxDepth(tmpMax) && tmpMax > maxDepth)
-          maxDepth = tmpMax;
-      }
+      double tmpMax;
+      if (contacts.MaxDepth(tmpMax) && tmpMax > maxDepth)
+        maxDepth = tmpMax;
       // std::cout << "Max depth: " << maxDepth << std::endl;
     }
     else
@@ -171,3 +180,124 @@ bool collision_benchmark::CollisionState(const std::string& modelName1,
   }
   return true;
 }
+
+////////////////////////////////////////////////////////////////
+collision_benchmark::CollisionVote::CollisionVote
+                        (const unsigned int _numVoters,
+                         const double _minAgree):
+  numVoters(_numVoters),
+  minAgree(_minAgree),
+  numColliding(0),
+  numNotColliding(0)
+{
+}
+
+////////////////////////////////////////////////////////////////
+void collision_benchmark::CollisionVote::Add(const bool colliding)
+{
+  if (colliding) ++numColliding;
+  else ++numNotColliding;
+}
+
+////////////////////////////////////////////////////////////////
+bool collision_benchmark::CollisionVote::IsAgreement
+                        (const unsigned int colliding) const
+{
+  if (numVoters == 0) return true;
+  double positive = colliding / (double) numVoters;
+  double negative = 1.0 - positive;
+  return !(((positive > negative) && (positive < minAgree)) ||
+           ((positive <= negative) && (negative < minAgree)));
+}
+
+////////////////////////////////////////////////////////////////
+bool collision_benchmark::CollisionVote::AgreementCertain() const
+{
+  // check all possible outcomes of the remaining votes
+  for (unsigned int c = numColliding;
+       c <= numVoters - numNotColliding; ++c)
+  {
+    if (!IsAgreement(c)) return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////
+bool collision_benchmark::CollisionAgreement
+                        (const std::string& modelName1,
+                         const std::string& modelName2,
+                         const GzWorldManager::Ptr& worldManager,
+                         const double minAgree,
+                         const double zeroDepthTol,
+                         bool& agree,
+                         std::vector<std::string>& colliding,
+                         std::vector<std::string>& notColliding,
+                         double& maxDepth)
+{
+  agree = false;
+  colliding.clear();
+  notColliding.clear();
+  maxDepth = 0;
+  if (!worldManager) return false;
+
+  GzWorldManager::WorldsSnapshotConstPtr snapshot =
+    worldManager->GetWorldsSnapshot();
+  const std::vector<GzWorldManager::PhysicsWorldPtr>&
+    worlds = snapshot->physicsWorlds;
+
+  if (worlds.empty())
+  {
+    agree = true;
+    return true;
+  }
+
+  // worlds which detect a collision, to extract the depth later if needed
+  static thread_local std::vector<GzWorldManager::PhysicsWorldPtr>
+    collidingWorlds;
+  collidingWorlds.clear();
+
+  CollisionVote vote(worlds.size(), minAgree);
+  std::vector<GzWorldManager::PhysicsWorldPtr>::const_iterator it;
+  for (it = worlds.begin(); it != worlds.end(); ++it)
+  {
+    const GzWorldManager::PhysicsWorldPtr& w = *it;
+    if (!w || !w->SupportsContacts())
+    {
+      std::cout<<"A world does not support contact calculation"<<std::endl;
+      collidingWorlds.clear();
+      return false;
+    }
+    bool hasContacts = w->HasContacts(modelName1, modelName2);
+    vote.Add(hasContacts);
+    if (hasContacts)
+    {
+      colliding.push_back(w->GetName());
+      collidingWorlds.push_back(w);
+    }
+    else
+    {
+      notColliding.push_back(w->GetName());
+    }
+    if (vote.AgreementCertain())
+    {
+      agree = true;
+      collidingWorlds.clear();
+      return true;
+    }
+  }
+
+  // the worlds disagree, unless there are only surface contacts.
+  // All worlds have been queried, so the depth is needed for the
+  // details of the disagreement as well.
+  static thread_local GzContactBuffer contacts;
+  for (it = collidingWorlds.begin(); it != collidingWorlds.end(); ++it)
+  {
+    (*it)->FillContactBuffer(modelName1, modelName2, contacts);
+    double tmpMax;
+    if (contacts.MaxDepth(tmpMax) && tmpMax > maxDepth)
+      maxDepth = tmpMax;
+  }
+  collidingWorlds.clear();
+  agree = !colliding.empty() && (fabs(maxDepth) < zeroDepthTol);
+  return true;
+}
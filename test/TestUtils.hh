@@ -50,6 +50,9 @@ namespace collision_benchmark
             GzContactInfo;
   typedef GzContactInfo::Ptr GzContactInfoPtr;
 
+  typedef GzWorldManager::PhysicsWorldContactInterfaceT::ContactBuffer
+            GzContactBuffer;
+
 
 
   // Tests if the worlds agree about the collision states
@@ -71,6 +74,63 @@ namespace collision_benchmark
                       std::vector<std::string>& notColliding,
                       double& maxDepth);
 
+  // Counts the votes of the worlds about the collision state of two
+  // models one by one, and determines as early as possible whether the
+  // worlds will agree about the collision state. The worlds agree if the
+  // fraction of worlds in the majority is at least \e minAgree.
+  class CollisionVote
+  {
+    public: CollisionVote(const unsigned int numVoters,
+                          const double minAgree);
+
+    // adds the vote of one world
+    public: void Add(const bool colliding);
+
+    // \return true if the worlds agree no matter how
+    //    the remaining worlds vote
+    public: bool AgreementCertain() const;
+
+    // \return true if the worlds agree when \e numColliding worlds
+    //    vote for collision and all others against it
+    private: bool IsAgreement(const unsigned int numColliding) const;
+
+    private: unsigned int numVoters;
+    private: double minAgree;
+    private: unsigned int numColliding;
+    private: unsigned int numNotColliding;
+  };
+
+  // Like CollisionState(), but determines whether the worlds agree about
+  // the collision state, and stops querying the worlds as soon as the
+  // result is certain. The worlds agree if the fraction of worlds in the
+  // majority is at least \e minAgree, or if all worlds which detect
+  // a collision only have surface contacts (largest depth within
+  // \e zeroDepthTol), because engines are allowed to disagree about these.
+  //
+  // Only whether there are contacts is queried from the worlds (see
+  // PhysicsWorldContactInterface::HasContacts()). The contact points are
+  // only extracted if the depth is needed to decide about the agreement.
+  //
+  // \param[out] agree true if the worlds agree
+  // \param[out] colliding names of engines which determine collision.
+  //    If \e agree is false, these are all engines, as in CollisionState().
+  //    Otherwise, only the engines queried until the agreement was certain.
+  // \param[out] notColliding as \e colliding, for engines which determine
+  //    no collision
+  // \param[out] maxDepth as in CollisionState() if \e agree is false,
+  //    otherwise 0 if the depth was not needed to decide.
+  // \return false if there was an inconsistency or error in querying
+  //    the collision states in any world
+  bool CollisionAgreement(const std::string& modelName1,
+                          const std::string& modelName2,
+                          const GzWorldManager::Ptr& worldManager,
+                          const double minAgree,
+                          const double zeroDepthTol,
+                          bool& agree,
+                          std::vector<std::string>& colliding,
+                          std::vector<std::string>& notColliding,
+                          double& maxDepth);
+
   // checks that AABB of model 1 is the same in all worlds in
   // \e worldManager and returns the AABBs of the model if it is
   // the same in all worlds.
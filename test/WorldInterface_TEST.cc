@@ -4,6 +4,7 @@
 #include <collision_benchmark/GazeboStateCompare.hh>
 #include <collision_benchmark/GazeboHelpers.hh>
 #include <collision_benchmark/WorldManager.hh>
+#include <collision_benchmark/WorldPool.hh>
 #include <collision_benchmark/PrimitiveShape.hh>
 #include <collision_benchmark/SimpleTriMeshShape.hh>
 #include <collision_benchmark/boost_std_conversion.hh>
@@ -22,6 +23,7 @@ using collision_benchmark::GazeboPhysicsWorld;
 using collision_benchmark::GazeboPhysicsWorldTypes;
 using collision_benchmark::GazeboStateCompare;
 using collision_benchmark::WorldManager;
+using collision_benchmark::WorldPool;
 using collision_benchmark::Shape;
 using collision_benchmark::PrimitiveShape;
 using collision_benchmark::MeshData;
@@ -158,6 +160,120 @@ TEST_F(WorldInterfaceTest, WorldManager)
   }
 }
 
+/**
+ * Tests that the parallel update mode of the WorldManager
+ * steps all worlds the same number of times.
+ */
+TEST_F(WorldInterfaceTest, WorldManagerParallelUpdate)
+{
+  std::map<std::string,std::string> physicsEngines
+    = collision_benchmark::getPhysicsSettingsSdfForAllEngines();
+  std::string worldfile = "../test_worlds/cube.world";
+
+  GzWorldManager worldManager;
+  std::vector<GazeboPhysicsWorld::Ptr> gzWorlds;
+  int i=1;
+  for (std::map<std::string,std::string>::iterator it = physicsEngines.begin();
+       it!=physicsEngines.end(); ++it, ++i)
+  {
+    std::stringstream _worldname;
+    _worldname << "parallel_world_" << i << "_" << it->first;
+    std::string worldname=_worldname.str();
+
+    sdf::ElementPtr physics =
+      collision_benchmark::GetPhysicsFromSDF(it->second);
+    ASSERT_NE(physics.get(), nullptr)
+      << "Could not get phyiscs engine from " << it->second << std::endl;
+
+    gazebo::physics::WorldPtr gzworld =
+      collision_benchmark::LoadWorldFromFile(worldfile, worldname, physics);
+    ASSERT_NE(gzworld.get(), nullptr)
+      << "Error loading world " << worldfile << std::endl;
+
+    GazeboPhysicsWorld::Ptr gzPhysicsWorld(new GazeboPhysicsWorld(false));
+    gzPhysicsWorld->SetWorld
+      (collision_benchmark::to_std_ptr<gazebo::physics::World>(gzworld));
+    worldManager.AddPhysicsWorld(gzPhysicsWorld);
+    gzWorlds.push_back(gzPhysicsWorld);
+  }
+
+  worldManager.SetParallelUpdate(true);
+  ASSERT_TRUE(worldManager.IsParallelUpdate());
+
+  std::vector<uint64_t> startIters;
+  for (std::vector<GazeboPhysicsWorld::Ptr>::iterator it = gzWorlds.begin();
+       it != gzWorlds.end(); ++it)
+  {
+    startIters.push_back((*it)->GetWorld()->Iterations());
+  }
+
+  int numIters = 100;
+  for (int k = 0; k < numIters; ++k)
+  {
+    worldManager.Update(1);
+  }
+
+  for (int k = 0; k < gzWorlds.size(); ++k)
+  {
+    EXPECT_EQ(gzWorlds[k]->GetWorld()->Iterations() - startIters[k], numIters)
+      << "World " << gzWorlds[k]->GetName() << " was not updated "
+      << "the expected number of times";
+  }
+
+  // split the updates into batches of 3 steps, which
+  // have to be run as 4 chained tasks per world
+  worldManager.SetParallelUpdate(true, 0, 3);
+  int numSteps = 10;
+  worldManager.Update(numSteps);
+  std::vector<collision_benchmark::WorkerPool::WorkerStatistics> stats =
+    worldManager.GetUpdateStatistics();
+  ASSERT_FALSE(stats.empty());
+  uint64_t numTasks = 0;
+  for (int k = 0; k < stats.size(); ++k)
+  {
+    std::cout << "Worker " << k << ": " << stats[k] << std::endl;
+    numTasks += stats[k].numTasks;
+  }
+  EXPECT_EQ(numTasks, 4 * gzWorlds.size());
+
+  for (int k = 0; k < gzWorlds.size(); ++k)
+  {
+    EXPECT_EQ(gzWorlds[k]->GetWorld()->Iterations() - startIters[k],
+              numIters + numSteps)
+      << "World " << gzWorlds[k]->GetName() << " was not updated "
+      << "the expected number of times";
+  }
+
+  // the step latency of each world is recorded in both update modes
+  worldManager.SetStepStatisticsEnabled(true);
+  worldManager.Update(numSteps);
+  worldManager.SetParallelUpdate(false);
+  ASSERT_FALSE(worldManager.IsParallelUpdate());
+  ASSERT_TRUE(worldManager.GetUpdateStatistics().empty());
+  worldManager.Update(numSteps);
+
+  GzWorldManager::StepStatistics stepStats =
+    worldManager.GetStepStatistics();
+  ASSERT_EQ(stepStats.worlds.size(), gzWorlds.size());
+  for (int k = 0; k < stepStats.worlds.size(); ++k)
+  {
+    const GzWorldManager::WorldStepStatistics& w = stepStats.worlds[k];
+    std::cout << w.worldName << ": " << w.stepLatency << std::endl;
+    EXPECT_EQ(w.worldName, gzWorlds[k]->GetName());
+    EXPECT_EQ(w.stepLatency.count, 2 * numSteps);
+    EXPECT_EQ(w.numUpdates, 2);
+  }
+
+  worldManager.ResetStepStatistics();
+  worldManager.SetStepStatisticsEnabled(false);
+  worldManager.Update(numSteps);
+  stepStats = worldManager.GetStepStatistics();
+  for (int k = 0; k < stepStats.worlds.size(); ++k)
+  {
+    EXPECT_EQ(stepStats.worlds[k].stepLatency.count, 0);
+  }
+}
+
 
 /**
  * Tests the model loading methods of the GazeboPhysicsWorld
@@ -265,6 +381,241 @@ TEST_F(WorldInterfaceTest, GazeboModelLoading)
     << "World "<<world->GetName()<<" should have 5 models.";
 }
 
+/**
+ * Tests setting the state of several models at once with
+ * PhysicsWorldModelInterface::SetBasicModelStates()
+ */
+TEST_F(WorldInterfaceTest, GazeboSetBasicModelStates)
+{
+  std::string worldfile = "worlds/empty.world";
+  GzPhysicsWorld::Ptr world (new GazeboPhysicsWorld(false));
+  ASSERT_EQ(world->LoadFromFile(worldfile),collision_benchmark::SUCCESS)
+    << " Could not load world";
+
+  int numModels = 10;
+  std::vector<std::pair<std::string, collision_benchmark::BasicState>> states;
+  for (int i = 0; i < numModels; ++i)
+  {
+    std::stringstream modelName;
+    modelName << "box_" << i;
+    Shape::Ptr shape(PrimitiveShape::CreateBox(0.1, 0.1, 0.1));
+    GzPhysicsWorld::ModelLoadResult res =
+      world->AddModelFromShape(modelName.str(), shape, shape);
+    ASSERT_EQ(res.opResult, collision_benchmark::SUCCESS)
+      << " Could not add model " << modelName.str();
+    collision_benchmark::BasicState s;
+    s.SetPosition(i, 2 * i, 3 * i);
+    states.push_back(std::make_pair(res.modelID, s));
+  }
+
+  ASSERT_EQ(world->SetBasicModelStates(states), numModels)
+    << "The states of all models should have been set";
+
+  for (int i = 0; i < numModels; ++i)
+  {
+    collision_benchmark::BasicState s;
+    ASSERT_TRUE(world->GetBasicModelState(states[i].first, s));
+    EXPECT_NEAR(s.position.x, i, 1e-06);
+    EXPECT_NEAR(s.position.y, 2 * i, 1e-06);
+    EXPECT_NEAR(s.position.z, 3 * i, 1e-06);
+  }
+
+  // models which don't exist are skipped
+  states.push_back(std::make_pair(std::string("no-such-model"),
+                                  collision_benchmark::BasicState()));
+  ASSERT_EQ(world->SetBasicModelStates(states), numModels);
+}
+
+/**
+ * Tests the model handles of the GazeboPhysicsWorld
+ */
+TEST_F(WorldInterfaceTest, GazeboModelHandles)
+{
+  std::string worldfile = "worlds/empty.world";
+  GazeboPhysicsWorld::Ptr world (new GazeboPhysicsWorld(false));
+  ASSERT_EQ(world->LoadFromFile(worldfile),collision_benchmark::SUCCESS)
+    << " Could not load world";
+
+  ASSERT_TRUE(world->GetModelHandle("no-such-model").IsNull());
+
+  Shape::Ptr shape(PrimitiveShape::CreateBox(0.1, 0.1, 0.1));
+  ASSERT_EQ(world->AddModelFromShape("box1", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+  ASSERT_EQ(world->AddModelFromShape("box2", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+
+  GazeboPhysicsWorld::ModelHandle h1 = world->GetModelHandle("box1");
+  GazeboPhysicsWorld::ModelHandle h2 = world->GetModelHandle("box2");
+  ASSERT_TRUE(world->IsValid(h1));
+  ASSERT_TRUE(world->IsValid(h2));
+  ASSERT_EQ(world->GetModel(h1)->GetName(), "box1");
+  ASSERT_EQ(world->GetIntegerModelID(h1), world->GetIntegerModelID("box1"));
+
+  collision_benchmark::BasicState state;
+  state.SetPosition(1, 2, 3);
+  ASSERT_TRUE(world->SetBasicModelState(h1, state));
+  collision_benchmark::BasicState getState;
+  ASSERT_TRUE(world->GetBasicModelState("box1", getState));
+  EXPECT_NEAR(getState.position.x, 1, 1e-06);
+  EXPECT_NEAR(getState.position.y, 2, 1e-06);
+  EXPECT_NEAR(getState.position.z, 3, 1e-06);
+
+  // removing a model invalidates its handle only
+  ASSERT_TRUE(world->RemoveModel(h1));
+  ASSERT_FALSE(world->IsValid(h1));
+  ASSERT_FALSE(world->SetBasicModelState(h1, state));
+  ASSERT_FALSE(world->RemoveModel(h1));
+  ASSERT_TRUE(world->GetModelHandle("box1").IsNull());
+  ASSERT_TRUE(world->IsValid(h2));
+
+  // removing a model directly from the Gazebo world invalidates its handle
+  ASSERT_EQ(world->AddModelFromShape("box3", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+  GazeboPhysicsWorld::ModelHandle h3 = world->GetModelHandle("box3");
+  ASSERT_TRUE(world->IsValid(h3));
+  collision_benchmark::to_boost_ptr<gazebo::physics::World>
+    (world->GetWorld())->RemoveModel("box3");
+  ASSERT_FALSE(world->IsValid(h3));
+  ASSERT_TRUE(world->GetModelHandle("box3").IsNull());
+  ASSERT_EQ(world->GetModel("box3"), nullptr);
+  ASSERT_TRUE(world->IsValid(h2));
+
+  // setting a state with the same models keeps the handles
+  ASSERT_EQ(world->SetWorldState(world->GetWorldState(), false),
+            collision_benchmark::SUCCESS);
+  ASSERT_TRUE(world->IsValid(h2));
+
+  // clearing the world invalidates all handles
+  world->Clear();
+  ASSERT_FALSE(world->IsValid(h2));
+}
+
+/**
+ * Tests that restoring a snapshot of the world sets the models back
+ * to their state when the snapshot was taken.
+ */
+TEST_F(WorldInterfaceTest, GazeboSnapshot)
+{
+  std::string worldfile = "../test_worlds/cube.world";
+  GazeboPhysicsWorld::Ptr world (new GazeboPhysicsWorld(false));
+  ASSERT_EQ(world->LoadFromFile(worldfile, "snapshot_world"),
+            collision_benchmark::SUCCESS) << " Could not load world";
+
+  // drop a sphere onto the cube, so the state changes while stepping
+  Shape::Ptr shape(PrimitiveShape::CreateSphere(0.2));
+  ASSERT_EQ(world->AddModelFromShape("sphere", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+  collision_benchmark::BasicState state;
+  state.SetPosition(0, 0, 3);
+  ASSERT_TRUE(world->SetBasicModelState("sphere", state));
+  world->Update(1);
+
+  GazeboPhysicsWorld::ModelHandle handle = world->GetModelHandle("sphere");
+  GazeboPhysicsWorld::Snapshot snapshot;
+  world->GetSnapshot(snapshot);
+  ASSERT_EQ(snapshot.modelNames.size(), 3);
+  GzWorldState startState = world->GetWorldState();
+
+  GazeboStateCompare::Tolerances t =
+    GazeboStateCompare::Tolerances::CreateDefault(1e-03);
+  for (int k = 0; k < 3; ++k)
+  {
+    world->Update(200);
+    ASSERT_FALSE(GazeboStateCompare::Equal(world->GetWorldState(),
+                                           startState, t));
+    ASSERT_TRUE(world->RestoreSnapshot(snapshot));
+    ASSERT_TRUE(GazeboStateCompare::Equal(world->GetWorldState(),
+                                          startState, t))
+      << "State was not restored from the snapshot";
+    // restoring a snapshot keeps the handles
+    ASSERT_TRUE(world->IsValid(handle));
+  }
+
+  // a snapshot can't be restored if the models have changed
+  ASSERT_EQ(world->AddModelFromShape("sphere2", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+  ASSERT_FALSE(world->RestoreSnapshot(snapshot));
+}
+
+/**
+ * Tests that a fork of the world has the same models and state,
+ * and then simulates independently of the original world.
+ */
+TEST_F(WorldInterfaceTest, GazeboFork)
+{
+  std::string worldfile = "../test_worlds/cube.world";
+  GazeboPhysicsWorld::Ptr world (new GazeboPhysicsWorld(false));
+  ASSERT_EQ(world->LoadFromFile(worldfile, "fork_source"),
+            collision_benchmark::SUCCESS) << " Could not load world";
+
+  Shape::Ptr shape(PrimitiveShape::CreateSphere(0.2));
+  ASSERT_EQ(world->AddModelFromShape("sphere", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+  collision_benchmark::BasicState state;
+  state.SetPosition(0, 0, 3);
+  ASSERT_TRUE(world->SetBasicModelState("sphere", state));
+  world->Update(50);
+
+  std::shared_ptr<GazeboPhysicsWorld> fork = world->Fork("fork_branch");
+  ASSERT_NE(fork.get(), nullptr) << "Could not fork world";
+  ASSERT_EQ(fork->GetName(), "fork_branch");
+  ASSERT_EQ(fork->GetAllModelIDs().size(), world->GetAllModelIDs().size());
+
+  GazeboStateCompare::Tolerances t =
+    GazeboStateCompare::Tolerances::CreateDefault(1e-03);
+  ASSERT_TRUE(GazeboStateCompare::Equal(fork->GetWorldState(),
+                                        world->GetWorldState(), t))
+    << "State of the fork differs from the original world";
+
+  // the fork is independent: moving its sphere doesn't move the original
+  state.SetPosition(0, 0, 10);
+  ASSERT_TRUE(fork->SetBasicModelState("sphere", state));
+  collision_benchmark::BasicState getState;
+  ASSERT_TRUE(world->GetBasicModelState("sphere", getState));
+  EXPECT_LT(getState.position.z, 5);
+}
+
+/**
+ * Tests that the world pool hands out empty worlds and recycles
+ * the worlds which were released.
+ */
+TEST_F(WorldInterfaceTest, WorldPool)
+{
+  WorldPool pool("worlds/empty.world", "test_pool");
+  collision_benchmark::WorldLoader::ConstPtr
+    loader(new collision_benchmark::GazeboWorldLoader("ode"));
+  pool.AddEngine(loader, 2);
+  pool.WaitUntilFilled();
+  ASSERT_EQ(pool.GetNumReady("ode"), 2);
+  ASSERT_EQ(pool.Acquire("no-such-engine"), nullptr);
+
+  PhysicsWorldBaseInterface::Ptr world = pool.Acquire("ode");
+  ASSERT_NE(world, nullptr) << "Could not acquire world";
+  GazeboPhysicsWorld::Ptr gzWorld =
+    std::dynamic_pointer_cast<GazeboPhysicsWorld>(world);
+  ASSERT_NE(gzWorld, nullptr);
+  ASSERT_EQ(gzWorld->GetPhysicsEngine()->GetType(), "ode");
+
+  Shape::Ptr shape(PrimitiveShape::CreateBox(0.1, 0.1, 0.1));
+  ASSERT_EQ(gzWorld->AddModelFromShape("box", shape, shape).opResult,
+            collision_benchmark::SUCCESS);
+  unsigned int numModels = gzWorld->GetAllModelIDs().size();
+
+  // the released world is cleared and handed out again
+  // once the pool runs out of ready worlds
+  ASSERT_TRUE(pool.Release(world));
+  ASSERT_FALSE(pool.Release(world));
+  pool.WaitUntilFilled();
+  std::set<PhysicsWorldBaseInterface*> worlds;
+  unsigned int numReady = pool.GetNumReady("ode");
+  for (unsigned int i = 0; i < numReady; ++i)
+  {
+    worlds.insert(pool.Acquire("ode").get());
+  }
+  ASSERT_EQ(worlds.count(world.get()), 1);
+  ASSERT_LT(gzWorld->GetAllModelIDs().size(), numModels);
+}
+
 /**
  * Tests the saving of the world. In particular, we want to test the
  * saving of worlds which have meshes which were generated with a shape.
@@ -403,6 +754,73 @@ TEST_F(WorldInterfaceTest, GazeboContacts)
       std::cout << "World has " << contacts1.size()
                 << " pair of colliding models." << std::endl;
       for (auto c: contacts1) std::cout<<*c<<std::endl;
+
+      // the interned IDs have to resolve to the names, and
+      // querying the pair has to return only contacts of this pair
+      GazeboPhysicsWorld::Ptr gzWorld =
+        std::dynamic_pointer_cast<GazeboPhysicsWorld>(world);
+      ASSERT_NE(gzWorld.get(), nullptr);
+      for (auto c: contacts1)
+      {
+        ASSERT_EQ(gzWorld->GetInternedName(c->model1Id), c->model1);
+        ASSERT_EQ(gzWorld->GetInternedName(c->modelPart1Id), c->modelPart1);
+        ASSERT_EQ(gzWorld->GetInternedName(c->model2Id), c->model2);
+        ASSERT_EQ(gzWorld->GetInternedName(c->modelPart2Id), c->modelPart2);
+        ASSERT_EQ(gzWorld->GetInternedId(c->model1), c->model1Id);
+        ASSERT_LT(c->model1, c->model2);
+        ASSERT_TRUE(c->isValid());
+        std::vector<GzPhysicsWorld::ContactInfoPtr> pairContacts =
+          world->GetContactInfo(c->model2, c->model1);
+        unsigned int numPairContacts = 0;
+        for (auto p: contacts1)
+        {
+          if (p->model1Id == c->model1Id && p->model2Id == c->model2Id)
+            ++numPairContacts;
+        }
+        ASSERT_EQ(pairContacts.size(), numPairContacts);
+        for (auto p: pairContacts)
+        {
+          ASSERT_EQ(p->model1Id, c->model1Id);
+          ASSERT_EQ(p->model2Id, c->model2Id);
+        }
+        ASSERT_FALSE(gzWorld->GetNativeContacts(c->model1, c->model2).empty());
+        ASSERT_TRUE(world->HasContacts(c->model1, c->model2));
+        ASSERT_TRUE(world->HasContacts(c->model2, c->model1));
+      }
+      ASSERT_EQ(gzWorld->GetInternedId("no-such-model"), -1);
+      ASSERT_FALSE(world->HasContacts("no-such-model", contacts1[0]->model1));
+
+      // the contact buffer has to contain the same contacts
+      GzPhysicsWorld::ContactBuffer buffer;
+      world->FillContactBuffer(buffer);
+      ASSERT_EQ(buffer.GetNumPairs(), contacts1.size());
+      unsigned int numContacts = 0;
+      for (unsigned int i = 0; i < buffer.GetNumPairs(); ++i)
+      {
+        const GzPhysicsWorld::ContactBuffer::Pair& p = buffer.GetPair(i);
+        ASSERT_EQ(p.model1Id, contacts1[i]->model1Id);
+        ASSERT_EQ(p.modelPart2Id, contacts1[i]->modelPart2Id);
+        ASSERT_EQ(buffer.GetModel1(i), contacts1[i]->model1);
+        ASSERT_EQ(buffer.GetModelPart2(i), contacts1[i]->modelPart2);
+        ASSERT_EQ(p.numContacts, contacts1[i]->contacts.size());
+        for (unsigned int c = 0; c < p.numContacts; ++c)
+        {
+          ASSERT_EQ(buffer.GetPairIndex(p.firstContact + c), i);
+          ASSERT_DOUBLE_EQ(buffer.GetDepth(p.firstContact + c),
+                           contacts1[i]->contacts[c].depth);
+        }
+        numContacts += p.numContacts;
+      }
+      ASSERT_EQ(buffer.GetNumContacts(), numContacts);
+      // re-filling the buffer has to give the same result
+      world->FillContactBuffer(buffer);
+      ASSERT_EQ(buffer.GetNumContacts(), numContacts);
+
+      // clearing the world discards the interned names, but the
+      // buffer can still look up the names of its pairs
+      gzWorld->Clear();
+      ASSERT_EQ(gzWorld->GetInternedId(contacts1[0]->model1), -1);
+      ASSERT_EQ(buffer.GetModel1(0), contacts1[0]->model1);
       break;
     }
   }